@@ -0,0 +1,812 @@
+/*****************************************************************************
+ * GKrellM nVidia                                                            *
+ * A plugin for GKrellM showing nVidia GPU info using libNVML                *
+ * Copyright (C) 2025 Carlo Casta <carlo.casta@gmail.com>                    *
+ *                                                                           *
+ * This program is free software; you can redistribute it and/or modify      *
+ * it under the terms of the GNU General Public License as published by      *
+ * the Free Software Foundation; either version 2 of the License, or         *
+ * (at your option) any later version.                                       *
+ *                                                                           *
+ * This program is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ * GNU General Public License for more details.                              *
+ *                                                                           *
+ * You should have received a copy of the GNU General Public License         *
+ * along with this program; if not, write to the Free Software               *
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA *
+ *                                                                           *
+ *****************************************************************************/
+
+/*
+ * headless benchmark for the per-tick path of the plugin: nvidia.c is
+ * built against the stubbed gkrellm api (gkrellm-stub.c) and the mock
+ * NVML library, then update_plugin() is timed for different GPU counts
+ * and counter selections. format_value() is also compared against the
+ * snprintf() calls it replaced, derived counter expressions and the
+ * trend fit against known answers, and the sample bus is read behind
+ * and against a writer thread. The plugin runs with a scratch home
+ * directory, so its history files are written and read back as the GPU
+ * count changes, and the ring file is checked on its own at the end.
+ * Then a GPU falls off the bus and comes back: it must be quarantined
+ * and then sampled again, without its neighbour noticing. Last, a GPU is
+ * split in MIG instances, some of them destroyed and created while it
+ * runs, and the snapshot and the rows must show what the mock reports.
+ *
+ * usage: bench-render <path to libnvidia-ml-mock.so> [ticks]
+ */
+#include "../nvidia.c"
+#include "gkrellm-stub.h"
+#include <dlfcn.h>
+#include <time.h>
+#include <stdatomic.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#define BENCH_WARMUP 100
+#define BENCH_TICKS 5000
+#define BENCH_FORMAT_VALUES 1024
+#define BENCH_FORMAT_ROUNDS 2000
+#define BENCH_RING_RECORDS 100000
+#define BENCH_LOST_TICKS 10
+#define BENCH_TREND_WINDOW 8
+#define BENCH_TREND_SAMPLES 10000
+#define BENCH_BUS_SLOTS 8
+#define BENCH_BUS_WORDS 64
+#define BENCH_BUS_RECORDS 1000000
+#define BENCH_TICK_MS 10
+
+/* idle instances and the slots in use are both looked at every 5 s */
+#define BENCH_MIG_WAIT_MS 12000
+
+#define PROP(p) (1u << (p))
+
+typedef struct {
+	const char *name;
+	guint mask;
+	guint spark_width;
+	gboolean derived;
+} BenchSelection;
+
+static const BenchSelection selections[] = {
+ { "all",        ~0u,                                               0, FALSE },
+ { "load+temp",  PROP(GPU_NAME) | PROP(GPU_USAGE) | PROP(GPU_TEMP), 0, FALSE },
+ { "memory",     PROP(GPU_NAME) | PROP(GPU_USEDMEM) |
+                 PROP(GPU_RESERVEDMEM) | PROP(GPU_TOTALMEM),        0, FALSE },
+ { "name only",  PROP(GPU_NAME),                                    0, FALSE },
+ { "all+spark",  ~0u,                                              40, FALSE },
+ { "derived",    PROP(GPU_NAME),                                    0, TRUE  }
+};
+
+/* the rows derived counters were asked for */
+static const char *bench_exprs[] = {
+	"load / power * 1000",
+	"(total - used - reserved) / 1073741824",
+	"memclock * mem_pct / 100"
+};
+
+/* count every heap allocation done in the process */
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t n, size_t size);
+extern void *__libc_realloc(void *p, size_t size);
+extern void __libc_free(void *p);
+
+static atomic_ullong bench_allocs;
+
+void *malloc(size_t size)
+{
+	atomic_fetch_add_explicit(&bench_allocs, 1, memory_order_relaxed);
+	return __libc_malloc(size);
+}
+
+void *calloc(size_t n, size_t size)
+{
+	atomic_fetch_add_explicit(&bench_allocs, 1, memory_order_relaxed);
+	return __libc_calloc(n, size);
+}
+
+void *realloc(void *p, size_t size)
+{
+	atomic_fetch_add_explicit(&bench_allocs, 1, memory_order_relaxed);
+	return __libc_realloc(p, size);
+}
+
+void free(void *p)
+{
+	__libc_free(p);
+}
+
+typedef void (*mock_set_fn)(guint);
+typedef void (*mock_lost_fn)(guint, int);
+typedef unsigned long long (*mock_calls_fn)(void);
+
+static mock_set_fn mock_set_gpus;
+static mock_set_fn mock_set_mig;
+static mock_set_fn mock_set_mig_slots;
+static mock_set_fn mock_set_mig_busy;
+static mock_lost_fn mock_set_lost;
+static mock_calls_fn mock_calls;
+
+static guint64 bench_now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (guint64)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static void bench_select(const BenchSelection *sel)
+{
+	guint i;
+
+	for (i = 0; i < GPU_PROPS_NUM; ++i) {
+		decal_info[i].enable = (sel->mask & PROP(decal_info[i].order)) != 0;
+		spark_config[i].width = sel->spark_width;
+	}
+
+	for (i = 0; i < GK_MAX_DERIVED; ++i)
+		set_derived_source(&derived_rows[i],
+		                   (sel->derived && i < ARRAY_SIZE(bench_exprs))? bench_exprs[i] : "");
+
+	rebuild_nv_panel();
+}
+
+static void bench_run(guint gpus, const BenchSelection *sel, guint ticks)
+{
+	guint i;
+	guint64 t0, t1, allocs, nvml_calls;
+	StubCounters c;
+
+	bench_select(sel);
+
+	for (i = 0; i < BENCH_WARMUP; ++i)
+		update_plugin();
+
+	memset(&stub_calls, 0, sizeof(stub_calls));
+	nvml_calls = mock_calls();
+	allocs = atomic_load(&bench_allocs);
+	t0 = bench_now_ns();
+
+	for (i = 0; i < ticks; ++i)
+		update_plugin();
+
+	t1 = bench_now_ns();
+	allocs = atomic_load(&bench_allocs) - allocs;
+	nvml_calls = mock_calls() - nvml_calls;
+	c = stub_calls;
+
+	printf("%4u  %-10s %10.0f %8.2f %8.2f %8.2f %8.2f %8.2f %8.2f %8.2f\n",
+	       gpus,
+	       sel->name,
+	       (double)(t1 - t0) / ticks,
+	       (double)allocs / ticks,
+	       (double)nvml_calls / ticks,
+	       (double)c.draw_decal_text / ticks,
+	       (double)c.decal_redraws / ticks,
+	       (double)c.string_width / ticks,
+	       (double)c.draw_panel_layers / ticks,
+	       (double)c.pixmap_draws / ticks);
+}
+
+/* one plugin tick, the state of every GPU ends up in panel_snapshot */
+static void bench_tick(void)
+{
+	struct timespec pause = { 0, BENCH_TICK_MS * 1000000l };
+
+	nanosleep(&pause, NULL);
+	update_plugin();
+}
+
+#define BENCH_LOST(i) ((panel_snapshot.lost & GPU_BIT(i)) != 0)
+#define BENCH_FRESH(i) ((panel_snapshot.fresh & GPU_BIT(i)) != 0)
+#define BENCH_DEGRADED(i) ((panel_snapshot.degraded & GPU_BIT(i)) != 0)
+
+/*
+ * GPU 1 of 2 is lost: it has to be marked lost within a few ticks while
+ * GPU 0 keeps being sampled, then found again by the recovery probe and
+ * sampled like before, neither lost nor degraded
+ */
+static gboolean bench_recovery(void)
+{
+	guint i, detect, recover, limit;
+	gboolean ok, degraded = FALSE, other_ok = TRUE;
+
+	mock_set_gpus(2);
+	create_plugin(gtk_vbox_new(FALSE, 0), TRUE);
+	bench_select(&selections[0]);
+
+	for (i = 0; i < BENCH_LOST_TICKS; ++i)
+		bench_tick();
+
+	mock_set_lost(1, TRUE);
+
+	for (detect = 1; detect <= BENCH_LOST_TICKS; ++detect) {
+		bench_tick();
+		other_ok &= !BENCH_LOST(0) && BENCH_FRESH(0);
+		if (BENCH_LOST(1))
+			break;
+	}
+
+	mock_set_lost(1, FALSE);
+
+	/* the probe runs every GK_RECOVER_PERIOD_MS, give it two goes */
+	limit = 2 * GK_RECOVER_PERIOD_MS / BENCH_TICK_MS;
+	for (recover = 1; BENCH_LOST(1) && recover <= limit; ++recover)
+		bench_tick();
+
+	/* and a few more samples after coming back */
+	for (i = 0; !BENCH_LOST(1) && i < BENCH_LOST_TICKS; ++i) {
+		bench_tick();
+		degraded |= BENCH_DEGRADED(1);
+	}
+
+	ok = detect <= BENCH_LOST_TICKS && !BENCH_LOST(1) && BENCH_FRESH(1) &&
+	     !degraded && other_ok;
+
+	shutdown_plugin();
+
+	printf("\nlost GPU: detected in %u ticks, recovered in %u ms, %s\n",
+	       detect,
+	       recover * BENCH_TICK_MS,
+	       ok? "ok" : "FAILED");
+
+	return ok;
+}
+
+/* busy ones between 10% and 90% of their memory, idle ones at 12MB */
+static gboolean bench_mig_sample(const NVMigSample *s, guint gb, gboolean busy)
+{
+	guint64 total = (guint64)gb << 30;
+
+	if (s->total != total)
+		return FALSE;
+
+	if (!busy)
+		return s->used == 12ull << 20 && s->usage == 0;
+
+	return s->used >= total / 10 && s->used <= total / 10 * 9 &&
+	       s->usage >= 20 && s->usage <= 100;
+}
+
+#define BENCH_MIG_SHOWN(j) mig_row_shown[MIG_ROW(0, (j))]
+#define BENCH_MIG_TEXT(j) mig_rows[MIG_ROW(0, (j))].text
+
+/*
+ * GPU 0 of 2 has a busy 3g.40gb, an idle 2g.20gb and two idle 1g.10gb,
+ * each one in a row. Then the busy instance is destroyed, three more are
+ * created and an idle one gets busy: the rows collapse into the busy one
+ * and a count of the others, and the parent is never degraded meanwhile.
+ */
+static gboolean bench_mig(void)
+{
+	guint i, limit, bad = 0;
+	gboolean parent_ok = TRUE;
+	const NVSnapshot *s = &panel_snapshot;
+
+	mock_set_gpus(2);
+	mock_set_mig(1);
+	mock_set_mig_slots(0x0f);
+	mock_set_mig_busy(0x01);
+	create_plugin(gtk_vbox_new(FALSE, 0), TRUE);
+	bench_select(&selections[0]);
+
+	for (i = 0; i < BENCH_LOST_TICKS; ++i)
+		bench_tick();
+
+	bad += s->mig_count != 4 || s->gpu[0].mig_count != 4 || s->mig_busy != 0x01;
+	bad += s->gpu[0].mig_busy != 1 || s->gpu[1].mig_busy != INVALID_PROP;
+	bad += !bench_mig_sample(&s->mig[0], 40, TRUE) ||
+	       !bench_mig_sample(&s->mig[1], 20, FALSE) ||
+	       !bench_mig_sample(&s->mig[2], 10, FALSE) ||
+	       !bench_mig_sample(&s->mig[3], 10, FALSE);
+
+	for (i = 0; i < GK_MIG_ROWS; ++i)
+		bad += BENCH_MIG_SHOWN(i) != i;
+	bad += strcmp(BENCH_MIG_TEXT(1), _("idle")) != 0;
+
+	mock_set_mig_slots(0x7e);
+	mock_set_mig_busy(0x08);
+
+	limit = BENCH_MIG_WAIT_MS / BENCH_TICK_MS;
+	for (i = 0; (s->mig_count != 6 || s->mig_busy != 0x04) && i < limit; ++i) {
+		bench_tick();
+		parent_ok &= !BENCH_LOST(0) && !BENCH_DEGRADED(0);
+	}
+
+	bench_tick();
+
+	/* slots 1 to 6, the one in slot 3 busy */
+	bad += s->mig_count != 6 || s->mig_busy != 0x04 || mig_info[2].index != 3;
+	bad += panel_mig_gen != s->mig_gen;
+	bad += !bench_mig_sample(&s->mig[2], 10, TRUE) ||
+	       !bench_mig_sample(&s->mig[3], 10, FALSE);
+	bad += BENCH_MIG_SHOWN(0) != 2 || BENCH_MIG_SHOWN(1) != GK_MIG_OTHERS ||
+	       BENCH_MIG_SHOWN(2) != GK_MIG_BLANK || BENCH_MIG_SHOWN(3) != GK_MIG_BLANK;
+	bad += strcmp(BENCH_MIG_TEXT(1), "+5") != 0;
+
+	shutdown_plugin();
+	mock_set_mig(0);
+
+	printf("\nMIG: %u instances, changes seen in %u ms, %s\n",
+	       s->mig_count,
+	       i * BENCH_TICK_MS,
+	       (!bad && parent_ok)? "ok" : "FAILED");
+
+	return !bad && parent_ok;
+}
+
+static guint64 bench_xorshift(guint64 *state)
+{
+	*state ^= *state << 13;
+	*state ^= *state >> 7;
+	*state ^= *state << 17;
+	return *state;
+}
+
+static void bench_format(void)
+{
+	guint i, r, k;
+	guint64 t0, t1, t2, seed = 0x9e3779b97f4a7c15ull, sink = 0;
+	guint64 values[BENCH_FORMAT_VALUES];
+	char buf[GK_MAX_TEXT];
+
+	static const struct {
+		const char *name;
+		ValueUnit_t unit;
+		guint64 range;
+	} cases[] = {
+	 { "MHz",    UNIT_MHZ,     3000         },
+	 { "C",      UNIT_CELSIUS, 100          },
+	 { "mW",     UNIT_MW,      600000       },
+	 { "bytes",  UNIT_BYTES,   80ull << 30  }
+	};
+
+	printf("\n%-8s %12s %12s\n", "unit", "snprintf ns", "format ns");
+
+	for (k = 0; k < ARRAY_SIZE(cases); ++k) {
+
+		for (i = 0; i < BENCH_FORMAT_VALUES; ++i)
+			values[i] = bench_xorshift(&seed) % cases[k].range;
+
+		/* what get_gpu_data() used to do for this unit */
+		t0 = bench_now_ns();
+		for (r = 0; r < BENCH_FORMAT_ROUNDS; ++r)
+			for (i = 0; i < BENCH_FORMAT_VALUES; ++i) {
+				switch (cases[k].unit) {
+				case UNIT_CELSIUS:
+					snprintf(buf, GK_MAX_TEXT, "%.01fC", (float)values[i]);
+					break;
+				case UNIT_MW:
+					snprintf(buf, GK_MAX_TEXT, "%lluW", values[i] / 1000);
+					break;
+				case UNIT_BYTES:
+					snprintf(buf, GK_MAX_TEXT, "%lluMB", values[i] / 0x100000);
+					break;
+				default:
+					snprintf(buf, GK_MAX_TEXT, "%lluMHz", values[i]);
+					break;
+				}
+				sink += buf[0];
+			}
+
+		t1 = bench_now_ns();
+		for (r = 0; r < BENCH_FORMAT_ROUNDS; ++r)
+			for (i = 0; i < BENCH_FORMAT_VALUES; ++i) {
+				format_value(buf, GK_MAX_TEXT, values[i], cases[k].unit, 1);
+				sink += buf[0];
+			}
+		t2 = bench_now_ns();
+
+		printf("%-8s %12.1f %12.1f\n",
+		       cases[k].name,
+		       (double)(t1 - t0) / (BENCH_FORMAT_ROUNDS * BENCH_FORMAT_VALUES),
+		       (double)(t2 - t1) / (BENCH_FORMAT_ROUNDS * BENCH_FORMAT_VALUES));
+	}
+
+	if (sink == 0)
+		printf("\n");
+}
+
+typedef struct {
+	const char *src;
+	gboolean compiles;
+	gboolean finite;
+	double result;
+} BenchExpr;
+
+/* total = 12, used = 4 */
+static const BenchExpr exprs[] = {
+ { "2 + 3 * 4",                TRUE,  TRUE,  14.0 },
+ { "(2 + 3) * 4",              TRUE,  TRUE,  20.0 },
+ { "10 - 4 - 3",               TRUE,  TRUE,   3.0 },
+ { "64 / 4 / 2",               TRUE,  TRUE,   8.0 },
+ { "2 * 3 / 4 * 2",            TRUE,  TRUE,   3.0 },
+ { "-3 * -2",                  TRUE,  TRUE,   6.0 },
+ { "-(2 + 3) - 1",             TRUE,  TRUE,  -6.0 },
+ { "2 - -3",                   TRUE,  TRUE,   5.0 },
+ { "(total - used) / 2",       TRUE,  TRUE,   4.0 },
+ { "used * 100 / total",       TRUE,  TRUE,  100.0 / 3.0 },
+ { "1 / 0",                    TRUE,  FALSE,  0.0 },
+ { "used / (total - 3 * used)", TRUE, FALSE,  0.0 },
+ { "0 / (total - total)",      TRUE,  FALSE,  0.0 },
+ { "free / total",             FALSE, FALSE,  0.0 },
+ { "(total - used",            FALSE, FALSE,  0.0 },
+ { "total - used)",            FALSE, FALSE,  0.0 },
+ { "()",                       FALSE, FALSE,  0.0 },
+ { "2 +",                      FALSE, FALSE,  0.0 }
+};
+
+/* known answers for the derived counters expressions, and known failures */
+static gboolean bench_counter_expr(void)
+{
+	static const char *const names[] = { "total", "used" };
+	const double vars[] = { 12.0, 4.0 };
+	guint k, bad = 0;
+	gboolean compiles, finite;
+	double result;
+	CounterExpr e;
+
+	for (k = 0; k < ARRAY_SIZE(exprs); ++k) {
+
+		compiles = counter_expr_compile(&e, exprs[k].src, names, ARRAY_SIZE(names));
+		finite = compiles && counter_expr_eval(&e, vars, &result);
+
+		if (compiles != exprs[k].compiles || finite != exprs[k].finite ||
+		    (finite && (result - exprs[k].result > 1e-9 ||
+		                exprs[k].result - result > 1e-9))) {
+			printf("counter expression \"%s\": %s\n", exprs[k].src,
+			       !compiles? "not compiled" : !finite? "not finite" : "wrong result");
+			++bad;
+		}
+	}
+
+	printf("\ncounter expressions: %u cases, %s\n",
+	       (guint)ARRAY_SIZE(exprs),
+	       bad? "FAILED" : "ok");
+
+	return !bad;
+}
+
+static guint64 bench_ring_value(guint64 n, guint f)
+{
+	return n * 31 + f;
+}
+
+static gboolean bench_near(double a, double b)
+{
+	return a - b <= 1e-9 && b - a <= 1e-9;
+}
+
+/*
+ * y = 40 + x / 2 sampled every second, x counted from a time base as far
+ * from 0 as a real clock: the line must come out the same before the
+ * window is rebased, right after and after thousands of samples, and so
+ * must the time it takes to reach a threshold (the slowdown estimate)
+ */
+static gboolean bench_trend_fit(void)
+{
+	const guint64 base = 1700000000000ull;
+	guint n, bad = 0;
+	double slope, value, secs;
+	TrendFit t;
+
+	trend_fit_init(&t, BENCH_TREND_WINDOW);
+
+	for (n = 0; n < BENCH_TREND_SAMPLES; ++n) {
+
+		trend_fit_add(&t, base + n * 1000ull, 40.0 + n / 2.0);
+
+		/* still on the first window, then on the third, the last one */
+		if (n != 4 && n != 2 * BENCH_TREND_WINDOW + 3 && n != BENCH_TREND_SAMPLES - 1)
+			continue;
+
+		bad += !trend_fit_get(&t, 2, &slope, &value) ||
+		       !bench_near(slope, 0.5) || !bench_near(value, 40.0 + n / 2.0);
+
+		/* 60 is reached 40 - n seconds after the newest sample */
+		if (n < 40)
+			bad += !trend_fit_eta(&t, 2, 0.1, 60.0, &secs) ||
+			       !bench_near(secs, 40.0 - n);
+	}
+
+	/* the origin follows the oldest sample at each rebase */
+	bad += t.origin != base + (BENCH_TREND_SAMPLES / BENCH_TREND_WINDOW - 1) *
+	                          BENCH_TREND_WINDOW * 1000ull;
+
+	/* a threshold behind, one approached too slowly, too few samples */
+	bad += !trend_fit_eta(&t, 2, 0.1, 45.0, &secs) || secs != 0.0;
+	bad += trend_fit_eta(&t, 2, 1.0, 1e9, &secs);
+	bad += trend_fit_get(&t, BENCH_TREND_WINDOW + 1, &slope, &value);
+
+	printf("\ntrend fit: %u samples, window %u, %s\n",
+	       BENCH_TREND_SAMPLES,
+	       BENCH_TREND_WINDOW,
+	       bad? "FAILED" : "ok");
+
+	return !bad;
+}
+
+/* every word tells the record number, a torn copy mixes two of them */
+typedef struct {
+	guint64 word[BENCH_BUS_WORDS];
+} BenchRecord;
+
+static SampleBus bench_bus;
+static BenchRecord bench_records[BENCH_BUS_SLOTS];
+static atomic_ullong bench_seq[BENCH_BUS_SLOTS];
+
+static void bench_bus_publish(guint64 n, gboolean commit)
+{
+	guint i;
+	BenchRecord *r = sample_bus_begin(&bench_bus);
+
+	for (i = 0; i < BENCH_BUS_WORDS; ++i)
+		r->word[i] = n;
+
+	if (commit)
+		sample_bus_commit(&bench_bus);
+}
+
+static gboolean bench_bus_whole(const BenchRecord *r)
+{
+	guint i;
+
+	for (i = 1; i < BENCH_BUS_WORDS; ++i)
+		if (r->word[i] != r->word[0])
+			return FALSE;
+
+	return TRUE;
+}
+
+static void *bench_bus_writer(void *data)
+{
+	guint64 n;
+	volatile guint spin;
+
+	/* about as fast as the reader copies, so both reads and laps happen */
+	for (n = (guint64)(long)data; n < BENCH_BUS_RECORDS; ++n) {
+		bench_bus_publish(n, TRUE);
+		for (spin = 0; spin < BENCH_BUS_WORDS; ++spin)
+			;
+	}
+
+	return NULL;
+}
+
+/*
+ * a reader more than a ring behind must skip to the oldest record still
+ * there, one whose slot is being written must skip that slot only, and
+ * one racing a writer must never get a torn copy nor miss a record
+ * without counting it as skipped
+ */
+static gboolean bench_sample_bus(void)
+{
+	guint64 n, expect, got = 0;
+	guint bad = 0;
+	BenchRecord r;
+	SampleCursor c;
+	pthread_t writer;
+
+	sample_bus_init(&bench_bus, bench_records, bench_seq,
+	                sizeof(BenchRecord), BENCH_BUS_SLOTS);
+	sample_bus_attach(&bench_bus, &c);
+
+	/* five records more than the ring holds */
+	for (n = 0; n < BENCH_BUS_SLOTS + 5; ++n)
+		bench_bus_publish(n, TRUE);
+
+	for (expect = 5; sample_bus_read(&bench_bus, &c, &r); ++expect)
+		bad += r.word[0] != expect || !bench_bus_whole(&r);
+	bad += expect != n || c.skipped != 5;
+
+	/* a full ring unread, then the oldest slot taken by a new record */
+	for (; n < 2 * BENCH_BUS_SLOTS + 5; ++n)
+		bench_bus_publish(n, TRUE);
+	bench_bus_publish(n, FALSE);
+
+	for (expect = n - BENCH_BUS_SLOTS + 1; sample_bus_read(&bench_bus, &c, &r); ++expect)
+		bad += r.word[0] != expect || !bench_bus_whole(&r);
+	bad += expect != n || c.skipped != 6;
+
+	sample_bus_commit(&bench_bus);
+	bad += !sample_bus_read(&bench_bus, &c, &r) || r.word[0] != n++;
+
+	/* and now against a writer thread */
+	c.skipped = 0;
+	expect = n;
+	pthread_create(&writer, NULL, bench_bus_writer, (void *)(long)n);
+
+	for (;;) {
+		if (!sample_bus_read(&bench_bus, &c, &r)) {
+			if (c.next == BENCH_BUS_RECORDS)
+				break;
+			continue;
+		}
+
+		/* in order, what was not read was counted as skipped */
+		++got;
+		bad += !bench_bus_whole(&r) || r.word[0] != c.next - 1 ||
+		       got + c.skipped != c.next - expect;
+	}
+
+	pthread_join(writer, NULL);
+
+	bad += got + c.skipped != BENCH_BUS_RECORDS - expect;
+
+	printf("\nsample bus: %llu of %llu records read racing the writer, %s\n",
+	       (unsigned long long)got,
+	       (unsigned long long)(BENCH_BUS_RECORDS - expect),
+	       bad? "FAILED" : "ok");
+
+	return !bad;
+}
+
+/*
+ * write a ring file well past its size, reopen it and read back what it
+ * must hold; then damage the header and make sure it is started over
+ */
+static gboolean bench_ring_file(const char *dir)
+{
+	RingFile r;
+	guint64 n, t0, t1, time;
+	guint a, f, bad = 0;
+	const guint64 *record;
+	guint64 *w;
+	char path[GK_MAX_PATH + 8];
+	FILE *file;
+
+	snprintf(path, sizeof(path), "%s/ring", dir);
+
+	if (!ring_file_open(&r, path, "bench", GPU_PROPS_NUM, GK_MAX_SPARK_W)) {
+		printf("\nring file: can't open %s\n", path);
+		return FALSE;
+	}
+
+	t0 = bench_now_ns();
+	for (n = 0; n < BENCH_RING_RECORDS; ++n) {
+		w = ring_file_begin(&r);
+		for (f = 0; f < GPU_PROPS_NUM; ++f)
+			w[f] = bench_ring_value(n, f);
+		ring_file_commit(&r, n);
+	}
+	t1 = bench_now_ns();
+
+	ring_file_close(&r);
+
+	/* only the newest records are left, as they were written */
+	if (!ring_file_open(&r, path, "bench", GPU_PROPS_NUM, GK_MAX_SPARK_W) ||
+	    ring_file_count(&r) != GK_MAX_SPARK_W)
+		++bad;
+
+	for (a = 0; !bad && a < ring_file_count(&r); ++a) {
+		n = BENCH_RING_RECORDS - 1 - a;
+		record = ring_file_get(&r, a, &time);
+		bad += (time != n);
+		for (f = 0; f < GPU_PROPS_NUM; ++f)
+			bad += (record[f] != bench_ring_value(n, f));
+	}
+
+	ring_file_close(&r);
+
+	/* one flipped byte of the key */
+	if ((file = fopen(path, "r+")) != NULL) {
+		fseek(file, 20, SEEK_SET);
+		fputc('X', file);
+		fclose(file);
+	}
+
+	if (!ring_file_open(&r, path, "bench", GPU_PROPS_NUM, GK_MAX_SPARK_W) ||
+	    ring_file_count(&r) != 0)
+		++bad;
+
+	ring_file_close(&r);
+	remove(path);
+
+	printf("\nring file: %.1f ns/record, read back %s, damaged header %s\n",
+	       (double)(t1 - t0) / BENCH_RING_RECORDS,
+	       bad? "FAILED" : "ok",
+	       bad? "-" : "reset");
+
+	return bad == 0;
+}
+
+/* what the plugin left in the scratch home directory */
+static void bench_remove_dir(const char *dir)
+{
+	DIR *d;
+	struct dirent *e;
+	char path[GK_MAX_PATH];
+
+	if ((d = opendir(dir)) != NULL) {
+		while ((e = readdir(d)) != NULL)
+			if (e->d_name[0] != '.' &&
+			    snprintf(path, sizeof(path), "%s/%s", dir, e->d_name) < (int)sizeof(path))
+				remove(path);
+		closedir(d);
+	}
+
+	rmdir(dir);
+}
+
+int main(int argc, char *argv[])
+{
+	void *mock;
+	guint gpus, s, ticks = BENCH_TICKS;
+	gboolean ok;
+	char home[] = "/tmp/bench-render-XXXXXX";
+	char user_path[GK_MAX_PATH];
+	GtkWidget *vbox = gtk_vbox_new(FALSE, 0);
+
+	if (argc < 2) {
+		fprintf(stderr, "usage: %s <mock nvml library> [ticks]\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	if (argc > 2)
+		ticks = MAX(1, atoi(argv[2]));
+
+	/* keep the mock loaded across plugin reinitializations */
+	mock = dlopen(argv[1], RTLD_NOW);
+	mock_set_gpus = mock? (mock_set_fn)dlsym(mock, "mock_nvml_set_gpus") : NULL;
+	mock_calls = mock? (mock_calls_fn)dlsym(mock, "mock_nvml_calls") : NULL;
+	mock_set_lost = mock? (mock_lost_fn)dlsym(mock, "mock_nvml_set_lost") : NULL;
+	mock_set_mig = mock? (mock_set_fn)dlsym(mock, "mock_nvml_set_mig") : NULL;
+	mock_set_mig_slots = mock? (mock_set_fn)dlsym(mock, "mock_nvml_set_mig_slots") : NULL;
+	mock_set_mig_busy = mock? (mock_set_fn)dlsym(mock, "mock_nvml_set_mig_busy") : NULL;
+
+	if (!mock_set_gpus || !mock_calls || !mock_set_lost ||
+	    !mock_set_mig || !mock_set_mig_slots || !mock_set_mig_busy) {
+		fprintf(stderr, "%s: %s is not the mock NVML library\n", argv[0], argv[1]);
+		return EXIT_FAILURE;
+	}
+
+	/* history and capabilities files go to a scratch directory */
+	if (mkdtemp(home)) {
+		snprintf(user_path, sizeof(user_path), "%s/%s", home, GKRELLM_DIR);
+		mkdir(user_path, 0755);
+		stub_homedir = home;
+	}
+
+	gkrellm_init_plugin();
+	load_plugin_config("");
+	snprintf(nvml.path, sizeof(nvml.path), "%s", argv[1]);
+
+	printf("%4s  %-10s %10s %8s %8s %8s %8s %8s %8s %8s\n",
+	       "gpus", "counters", "ns/tick", "allocs", "nvml",
+	       "decals", "redraws", "widths", "layers", "pixmaps");
+
+	for (gpus = 1; gpus <= GK_MAX_GPUS; ++gpus) {
+
+		mock_set_gpus(gpus);
+		create_plugin(vbox, TRUE);
+
+		for (s = 0; s < ARRAY_SIZE(selections); ++s)
+			bench_run(gpus, &selections[s], ticks);
+
+		shutdown_plugin();
+	}
+
+	ok = bench_recovery();
+	ok = bench_mig() && ok;
+
+	dlclose(mock);
+
+	bench_format();
+
+	ok = bench_counter_expr() && ok;
+	ok = bench_trend_fit() && ok;
+	ok = bench_sample_bus() && ok;
+
+	ok = (stub_homedir == home) && bench_ring_file(user_path) && ok;
+
+	if (stub_homedir == home) {
+		bench_remove_dir(user_path);
+		rmdir(home);
+	}
+
+	return ok? EXIT_SUCCESS : EXIT_FAILURE;
+}
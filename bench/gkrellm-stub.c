@@ -0,0 +1,501 @@
+/*****************************************************************************
+ * GKrellM nVidia                                                            *
+ * A plugin for GKrellM showing nVidia GPU info using libNVML                *
+ * Copyright (C) 2025 Carlo Casta <carlo.casta@gmail.com>                    *
+ *                                                                           *
+ * This program is free software; you can redistribute it and/or modify      *
+ * it under the terms of the GNU General Public License as published by      *
+ * the Free Software Foundation; either version 2 of the License, or         *
+ * (at your option) any later version.                                       *
+ *                                                                           *
+ * This program is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ * GNU General Public License for more details.                              *
+ *                                                                           *
+ * You should have received a copy of the GNU General Public License         *
+ * along with this program; if not, write to the Free Software               *
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA *
+ *                                                                           *
+ *****************************************************************************/
+#include <gkrellm2/gkrellm.h>
+#include "gkrellm-stub.h"
+#include <time.h>
+
+#define STUB_TEXT 64
+#define STUB_MAX_DECALS 1024
+#define STUB_FONT_WIDTH 6
+
+typedef struct {
+	GkrellmDecal decal;
+	gchar text[STUB_TEXT];
+} StubDecal;
+
+StubCounters stub_calls;
+const char *stub_homedir = "/nonexistent";
+
+static StubDecal stub_decals[STUB_MAX_DECALS];
+static gint stub_decal_count;
+
+static GtkWidget stub_widget;
+static GkrellmPanel stub_panel = { &stub_widget, NULL, NULL, 0 };
+static GkrellmStyle stub_style = { { 2, 2, 2, 2 } };
+static GkrellmTextstyle stub_textstyle;
+static GkrellmTextstyle stub_alt_textstyle;
+
+/* glib / gobject */
+
+unsigned long g_signal_connect_data(gpointer o, const gchar *s,
+                                    void (*f)(void), gpointer d)
+{
+	(void)o; (void)s; (void)f; (void)d;
+	return 1;
+}
+
+gint g_list_index(GList *list, gpointer data)
+{
+	gint i;
+
+	for (i = 0; list; list = list->next, ++i)
+		if (list->data == data)
+			return i;
+
+	return -1;
+}
+
+void g_object_unref(gpointer object)
+{
+	(void)object;
+}
+
+gint64 g_get_real_time(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+
+	return (gint64)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/* there is no main loop, pending events are picked up by update_plugin() */
+guint g_idle_add(gboolean (*function)(gpointer), gpointer data)
+{
+	(void)function; (void)data;
+	return 1;
+}
+
+/* gtk: config tab is never built by the benchmark */
+
+GtkWidget *gtk_vbox_new(gboolean homogeneous, gint spacing)
+{
+	(void)homogeneous; (void)spacing;
+	return &stub_widget;
+}
+
+GtkWidget *gtk_hbox_new(gboolean homogeneous, gint spacing)
+{
+	(void)homogeneous; (void)spacing;
+	return &stub_widget;
+}
+
+GtkWidget *gtk_label_new(const gchar *str)
+{
+	(void)str;
+	return &stub_widget;
+}
+
+GtkWidget *gtk_entry_new_with_max_length(gint max)
+{
+	(void)max;
+	return &stub_widget;
+}
+
+GtkWidget *gtk_notebook_new(void)
+{
+	return &stub_widget;
+}
+
+void gtk_box_pack_start(GtkWidget *box, GtkWidget *child, gboolean expand,
+                        gboolean fill, guint padding)
+{
+	(void)box; (void)child; (void)expand; (void)fill; (void)padding;
+}
+
+void gtk_box_pack_end(GtkWidget *box, GtkWidget *child, gboolean expand,
+                      gboolean fill, guint padding)
+{
+	(void)box; (void)child; (void)expand; (void)fill; (void)padding;
+}
+
+void gtk_box_reorder_child(GtkWidget *box, GtkWidget *child, gint position)
+{
+	(void)box; (void)child; (void)position;
+}
+
+void gtk_widget_show(GtkWidget *widget)
+{
+	(void)widget;
+}
+
+void gtk_widget_destroyed(GtkWidget *widget, GtkWidget **widget_pointer)
+{
+	(void)widget;
+	*widget_pointer = NULL;
+}
+
+GtkWidget *gtk_widget_get_ancestor(GtkWidget *widget, gint type)
+{
+	(void)type;
+	return widget;
+}
+
+GList *gtk_container_get_children(GtkWidget *container)
+{
+	(void)container;
+	return NULL;
+}
+
+gboolean gtk_toggle_button_get_active(GtkWidget *button)
+{
+	(void)button;
+	return FALSE;
+}
+
+gint gtk_spin_button_get_value_as_int(GtkWidget *spin)
+{
+	(void)spin;
+	return 0;
+}
+
+void gtk_label_set_text(GtkWidget *label, const gchar *str)
+{
+	(void)label; (void)str;
+}
+
+void gtk_entry_set_text(GtkWidget *entry, const gchar *text)
+{
+	(void)entry; (void)text;
+}
+
+void gtk_entry_set_icon_from_icon_name(GtkWidget *entry, gint pos,
+                                       const gchar *icon)
+{
+	(void)entry; (void)pos; (void)icon;
+}
+
+void gtk_notebook_set_tab_pos(GtkWidget *notebook, gint pos)
+{
+	(void)notebook; (void)pos;
+}
+
+void gtk_drag_source_set(GtkWidget *widget, gint mask,
+                         const GtkTargetEntry *targets, gint n, gint actions)
+{
+	(void)widget; (void)mask; (void)targets; (void)n; (void)actions;
+}
+
+void gtk_drag_dest_set(GtkWidget *widget, gint flags,
+                       const GtkTargetEntry *targets, gint n, gint actions)
+{
+	(void)widget; (void)flags; (void)targets; (void)n; (void)actions;
+}
+
+void gtk_selection_data_set(GtkSelectionData *data, gpointer type,
+                            gint format, const guchar *d, gint length)
+{
+	(void)data; (void)type; (void)format; (void)d; (void)length;
+}
+
+gpointer gtk_selection_data_get_target(GtkSelectionData *data)
+{
+	(void)data;
+	return NULL;
+}
+
+const guchar *gtk_selection_data_get_data(GtkSelectionData *data)
+{
+	(void)data;
+	return NULL;
+}
+
+/* gdk */
+
+void gdk_draw_pixmap(GdkDrawable *drawable, GdkGC *gc, GdkDrawable *src,
+                     gint xsrc, gint ysrc, gint xdest, gint ydest,
+                     gint width, gint height)
+{
+	(void)drawable; (void)gc; (void)src; (void)xsrc; (void)ysrc;
+	(void)xdest; (void)ydest; (void)width; (void)height;
+
+	++stub_calls.pixmap_draws;
+}
+
+/* drawables and GCs are never dereferenced, any non NULL pointer will do */
+GdkPixmap *gdk_pixmap_new(GdkDrawable *drawable, gint width, gint height,
+                          gint depth)
+{
+	(void)drawable; (void)width; (void)height; (void)depth;
+	return (GdkPixmap*)&stub_widget;
+}
+
+GdkGC *gdk_gc_new(GdkDrawable *drawable)
+{
+	(void)drawable;
+	return (GdkGC*)&stub_widget;
+}
+
+void gdk_gc_set_foreground(GdkGC *gc, const GdkColor *color)
+{
+	(void)gc; (void)color;
+}
+
+void gdk_draw_rectangle(GdkDrawable *drawable, GdkGC *gc, gboolean filled,
+                        gint x, gint y, gint width, gint height)
+{
+	(void)drawable; (void)gc; (void)filled;
+	(void)x; (void)y; (void)width; (void)height;
+
+	++stub_calls.pixmap_draws;
+}
+
+void gdk_draw_line(GdkDrawable *drawable, GdkGC *gc,
+                   gint x1, gint y1, gint x2, gint y2)
+{
+	(void)drawable; (void)gc; (void)x1; (void)y1; (void)x2; (void)y2;
+
+	++stub_calls.pixmap_draws;
+}
+
+/* gkrellm */
+
+gint gkrellm_add_meter_style(GkrellmMonitor *mon, gchar *name)
+{
+	(void)mon; (void)name;
+	return 0;
+}
+
+GkrellmStyle *gkrellm_panel_style(gint style_id)
+{
+	(void)style_id;
+	return &stub_style;
+}
+
+GkrellmStyle *gkrellm_meter_style(gint style_id)
+{
+	(void)style_id;
+	return &stub_style;
+}
+
+GkrellmTextstyle *gkrellm_meter_textstyle(gint style_id)
+{
+	(void)style_id;
+	return &stub_textstyle;
+}
+
+GkrellmTextstyle *gkrellm_meter_alt_textstyle(gint style_id)
+{
+	(void)style_id;
+	return &stub_alt_textstyle;
+}
+
+GkrellmMargin *gkrellm_get_style_margins(GkrellmStyle *style)
+{
+	return &style->margin;
+}
+
+gint gkrellm_chart_width(void)
+{
+	return 100;
+}
+
+GkrellmPanel *gkrellm_panel_new0(void)
+{
+	return &stub_panel;
+}
+
+void gkrellm_panel_configure(GkrellmPanel *p, gchar *string,
+                             GkrellmStyle *style)
+{
+	(void)p; (void)string; (void)style;
+}
+
+void gkrellm_panel_create(GtkWidget *vbox, GkrellmMonitor *mon,
+                          GkrellmPanel *p)
+{
+	(void)vbox; (void)mon; (void)p;
+}
+
+void gkrellm_panel_destroy(GkrellmPanel *p)
+{
+	(void)p;
+	stub_decal_count = 0;
+}
+
+GkrellmDecal *gkrellm_create_decal_text(GkrellmPanel *p, gchar *string,
+                                        GkrellmTextstyle *ts,
+                                        GkrellmStyle *style,
+                                        gint x, gint y, gint w)
+{
+	StubDecal *d;
+
+	(void)p; (void)style; (void)w;
+
+	if (stub_decal_count == STUB_MAX_DECALS) {
+		fprintf(stderr, "gkrellm-stub: too many decals\n");
+		exit(EXIT_FAILURE);
+	}
+
+	d = &stub_decals[stub_decal_count++];
+	memset(d, 0, sizeof(*d));
+
+	d->decal.x = (x < 0)? 0 : x;
+	d->decal.y = (y < 0)? 0 : y;
+	d->decal.h = 12;
+	d->decal.w = gkrellm_gdk_string_width(ts->font, string);
+	d->decal.text_style = *ts;
+	d->decal.value = -1;
+	d->decal.text = d->text;
+
+	return &d->decal;
+}
+
+GkrellmDecal *gkrellm_create_decal_pixmap(GkrellmPanel *p, GdkPixmap *pixmap,
+                                          GdkBitmap *mask, gint depth,
+                                          GkrellmStyle *style, gint x, gint y)
+{
+	StubDecal *d;
+
+	(void)p; (void)style;
+
+	if (stub_decal_count == STUB_MAX_DECALS) {
+		fprintf(stderr, "gkrellm-stub: too many decals\n");
+		exit(EXIT_FAILURE);
+	}
+
+	d = &stub_decals[stub_decal_count++];
+	memset(d, 0, sizeof(*d));
+
+	d->decal.pixmap = pixmap;
+	d->decal.mask = mask;
+	d->decal.x = x;
+	d->decal.y = (y < 0)? 0 : y;
+	/* pixmap size is unknown here, assume sparkline height */
+	d->decal.h = 8 / ((depth > 0)? depth : 1);
+	d->decal.value = -1;
+	d->decal.text = d->text;
+
+	return &d->decal;
+}
+
+GtkWidget *gkrellm_get_top_window(void)
+{
+	return &stub_widget;
+}
+
+/* same early-out as gkrellm: unchanged text and value draw nothing */
+void gkrellm_draw_decal_text(GkrellmPanel *p, GkrellmDecal *d,
+                             gchar *text, gint value)
+{
+	(void)p;
+
+	++stub_calls.draw_decal_text;
+
+	if (d->value == value && !strcmp(d->text, text))
+		return;
+
+	++stub_calls.decal_redraws;
+	d->value = value;
+	snprintf(d->text, STUB_TEXT, "%s", text);
+}
+
+void gkrellm_decal_text_clear(GkrellmDecal *d)
+{
+	d->text[0] = '\0';
+	d->value = -1;
+}
+
+gint gkrellm_gdk_string_width(PangoFontDescription *font, gchar *string)
+{
+	(void)font;
+
+	++stub_calls.string_width;
+
+	return (gint)strlen(string) * STUB_FONT_WIDTH;
+}
+
+void gkrellm_draw_panel_layers(GkrellmPanel *p)
+{
+	(void)p;
+
+	++stub_calls.draw_panel_layers;
+}
+
+void gkrellm_disable_plugin_connect(GkrellmMonitor *mon, void (*cb)(void))
+{
+	(void)mon; (void)cb;
+}
+
+void gkrellm_open_config_window(GkrellmMonitor *mon)
+{
+	(void)mon;
+}
+
+void gkrellm_dup_string(gchar **dst, gchar *src)
+{
+	*dst = src;
+}
+
+/* no user directory unless the benchmark picks one */
+gchar *gkrellm_homedir(void)
+{
+	return (gchar *)stub_homedir;
+}
+
+gchar *gkrellm_gtk_entry_get_text(GtkWidget **entry)
+{
+	(void)entry;
+	return "";
+}
+
+GtkWidget *gkrellm_gtk_framed_notebook_page(GtkWidget *tabs, char *name)
+{
+	(void)tabs; (void)name;
+	return &stub_widget;
+}
+
+GtkWidget *gkrellm_gtk_framed_vbox(GtkWidget *box, gchar *label,
+                                   gint frame_border_width,
+                                   gboolean frame_expand,
+                                   gint vbox_pad, gint vbox_border_width)
+{
+	(void)box; (void)label; (void)frame_border_width; (void)frame_expand;
+	(void)vbox_pad; (void)vbox_border_width;
+	return &stub_widget;
+}
+
+void gkrellm_gtk_check_button_connected(GtkWidget *box, GtkWidget **button,
+                                        gboolean active, gboolean expand,
+                                        gboolean fill, gint pad,
+                                        void (*cb_func)(), gpointer data,
+                                        gchar *string)
+{
+	(void)box; (void)active; (void)expand; (void)fill; (void)pad;
+	(void)cb_func; (void)data; (void)string;
+
+	if (button)
+		*button = &stub_widget;
+}
+
+void gkrellm_gtk_spin_button(GtkWidget *box, GtkWidget **spin_button,
+                             gfloat value, gfloat low, gfloat high,
+                             gfloat step0, gfloat step1, gint digits,
+                             gint width, void (*cb_func)(), gpointer data,
+                             gboolean right_align, gchar *string)
+{
+	(void)box; (void)value; (void)low; (void)high; (void)step0;
+	(void)step1; (void)digits; (void)width; (void)cb_func; (void)data;
+	(void)right_align; (void)string;
+
+	if (spin_button)
+		*spin_button = &stub_widget;
+}
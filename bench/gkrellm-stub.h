@@ -0,0 +1,38 @@
+/*****************************************************************************
+ * GKrellM nVidia                                                            *
+ * A plugin for GKrellM showing nVidia GPU info using libNVML                *
+ * Copyright (C) 2025 Carlo Casta <carlo.casta@gmail.com>                    *
+ *                                                                           *
+ * This program is free software; you can redistribute it and/or modify      *
+ * it under the terms of the GNU General Public License as published by      *
+ * the Free Software Foundation; either version 2 of the License, or         *
+ * (at your option) any later version.                                       *
+ *                                                                           *
+ * This program is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ * GNU General Public License for more details.                              *
+ *                                                                           *
+ * You should have received a copy of the GNU General Public License         *
+ * along with this program; if not, write to the Free Software               *
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA *
+ *                                                                           *
+ *****************************************************************************/
+#ifndef GKRELLM_STUB_COUNTERS_H
+#define GKRELLM_STUB_COUNTERS_H
+
+/* calls into the stubbed gkrellm drawing api, reset by the benchmark */
+typedef struct {
+	unsigned long long draw_decal_text;
+	unsigned long long decal_redraws;
+	unsigned long long string_width;
+	unsigned long long draw_panel_layers;
+	unsigned long long pixmap_draws;
+} StubCounters;
+
+extern StubCounters stub_calls;
+
+/* where the plugin keeps its files, none by default */
+extern const char *stub_homedir;
+
+#endif /* GKRELLM_STUB_COUNTERS_H */
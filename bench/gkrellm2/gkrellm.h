@@ -0,0 +1,284 @@
+/*****************************************************************************
+ * GKrellM nVidia                                                            *
+ * A plugin for GKrellM showing nVidia GPU info using libNVML                *
+ * Copyright (C) 2025 Carlo Casta <carlo.casta@gmail.com>                    *
+ *                                                                           *
+ * This program is free software; you can redistribute it and/or modify      *
+ * it under the terms of the GNU General Public License as published by      *
+ * the Free Software Foundation; either version 2 of the License, or         *
+ * (at your option) any later version.                                       *
+ *                                                                           *
+ * This program is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ * GNU General Public License for more details.                              *
+ *                                                                           *
+ * You should have received a copy of the GNU General Public License         *
+ * along with this program; if not, write to the Free Software               *
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA *
+ *                                                                           *
+ *****************************************************************************/
+
+/*
+ * minimal stand-in for <gkrellm2/gkrellm.h> used by the headless benchmark:
+ * only the types, macros and functions nvidia.c actually touches are
+ * declared here, everything is implemented as a (counting) no-op in
+ * gkrellm-stub.c
+ */
+#ifndef GKRELLM_STUB_H
+#define GKRELLM_STUB_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+
+typedef int gint;
+typedef unsigned int guint;
+typedef int gboolean;
+typedef char gchar;
+typedef unsigned char guchar;
+typedef unsigned int guint32;
+typedef long long gint64;
+typedef unsigned long long guint64;
+typedef float gfloat;
+typedef double gdouble;
+typedef void* gpointer;
+
+#ifndef FALSE
+ #define FALSE (0)
+#endif
+#ifndef TRUE
+ #define TRUE (!FALSE)
+#endif
+
+#define _(s) (s)
+#define MAX(a, b) (((a) > (b))? (a) : (b))
+#define MIN(a, b) (((a) < (b))? (a) : (b))
+#define CLAMP(x, lo, hi) (((x) > (hi))? (hi) : (((x) < (lo))? (lo) : (x)))
+
+#define GINT_TO_POINTER(i) ((gpointer)(long)(i))
+#define GPOINTER_TO_INT(p) ((gint)(long)(p))
+
+#define CFG_BUFSIZE 512
+#define GKRELLM_DIR ".gkrellm2"
+
+#define MON_CPU 0
+#define MON_INSERT_AFTER 0x200
+
+typedef struct _GList {
+	gpointer data;
+	struct _GList *next;
+	struct _GList *prev;
+} GList;
+
+typedef struct _GdkRectangle {
+	gint x, y, width, height;
+} GdkRectangle;
+
+typedef struct _GdkColor {
+	guint32 pixel;
+	unsigned short red, green, blue;
+} GdkColor;
+
+typedef struct _GdkDrawable GdkDrawable;
+typedef GdkDrawable GdkWindow;
+typedef GdkDrawable GdkPixmap;
+typedef GdkDrawable GdkBitmap;
+typedef struct _GdkGC GdkGC;
+typedef struct _GdkDragContext GdkDragContext;
+typedef struct _GtkSelectionData GtkSelectionData;
+typedef struct _PangoFontDescription PangoFontDescription;
+
+typedef struct _GtkStyle {
+	GdkGC *fg_gc[5];
+} GtkStyle;
+
+typedef struct _GtkWidget {
+	GdkWindow *window;
+	GtkStyle *style;
+} GtkWidget;
+
+typedef struct _GdkEventExpose {
+	GdkRectangle area;
+} GdkEventExpose;
+
+typedef struct _GdkEventButton {
+	guint button;
+} GdkEventButton;
+
+typedef struct _GtkTargetEntry {
+	gchar *target;
+	guint flags;
+	guint info;
+} GtkTargetEntry;
+
+typedef struct _GkrellmMargin {
+	gint left, right, top, bottom;
+} GkrellmMargin;
+
+typedef struct _GkrellmTextstyle {
+	PangoFontDescription *font;
+	GdkColor color;
+	gint effect;
+} GkrellmTextstyle;
+
+typedef struct _GkrellmStyle {
+	GkrellmMargin margin;
+} GkrellmStyle;
+
+typedef struct _GkrellmDecal {
+	GdkPixmap *pixmap;
+	GdkBitmap *mask;
+	gint x, y, w, h;
+	GkrellmTextstyle text_style;
+	gint value;
+	gboolean modified;
+	gchar *text;
+} GkrellmDecal;
+
+typedef struct _GkrellmPanel {
+	GtkWidget *drawing_area;
+	GdkPixmap *pixmap;
+	GdkPixmap *bg_pixmap;
+	gint h;
+} GkrellmPanel;
+
+typedef struct _GkrellmMonitor {
+	gchar *name;
+	gint id;
+	void (*create_monitor)(GtkWidget *, gint);
+	void (*update_monitor)(void);
+	void (*create_config)(GtkWidget *);
+	void (*apply_config)(void);
+	void (*save_user_config)(FILE *);
+	void (*load_user_config)(gchar *);
+	gchar *config_keyword;
+	void (*undef2)(void);
+	void (*undef1)(void);
+	void *privat;
+	gint insert_before_id;
+	void *handle;
+	gchar *path;
+} GkrellmMonitor;
+
+/* glib / gobject */
+#define G_OBJECT(o) ((gpointer)(o))
+#define G_CALLBACK(f) ((void (*)(void))(f))
+#define g_signal_connect(o, s, f, d) g_signal_connect_data((o), (s), (f), (d))
+unsigned long g_signal_connect_data(gpointer o, const gchar *s,
+                                    void (*f)(void), gpointer d);
+gint g_list_index(GList *list, gpointer data);
+guint g_idle_add(gboolean (*function)(gpointer), gpointer data);
+void g_object_unref(gpointer object);
+gint64 g_get_real_time(void);
+
+/* gtk */
+#define GTK_WIDGET_STATE(w) 0
+#define GTK_BOX(w) (w)
+#define GTK_NOTEBOOK(w) (w)
+#define GTK_ENTRY(w) (w)
+#define GTK_TOGGLE_BUTTON(w) (w)
+#define GTK_SPIN_BUTTON(w) (w)
+#define GTK_LABEL(w) (w)
+#define GTK_CONTAINER(w) (w)
+#define GTK_TYPE_BOX 0
+#define GTK_POS_TOP 2
+#define GTK_ENTRY_ICON_SECONDARY 1
+#define GTK_TARGET_SAME_APP 1
+#define GTK_DEST_DEFAULT_ALL 7
+#define GDK_BUTTON1_MASK (1 << 8)
+#define GDK_ACTION_MOVE (1 << 2)
+
+GtkWidget *gtk_vbox_new(gboolean homogeneous, gint spacing);
+GtkWidget *gtk_hbox_new(gboolean homogeneous, gint spacing);
+GtkWidget *gtk_label_new(const gchar *str);
+GtkWidget *gtk_entry_new_with_max_length(gint max);
+GtkWidget *gtk_notebook_new(void);
+void gtk_box_pack_start(GtkWidget *box, GtkWidget *child, gboolean expand,
+                        gboolean fill, guint padding);
+void gtk_box_pack_end(GtkWidget *box, GtkWidget *child, gboolean expand,
+                      gboolean fill, guint padding);
+void gtk_box_reorder_child(GtkWidget *box, GtkWidget *child, gint position);
+void gtk_widget_show(GtkWidget *widget);
+void gtk_widget_destroyed(GtkWidget *widget, GtkWidget **widget_pointer);
+GtkWidget *gtk_widget_get_ancestor(GtkWidget *widget, gint type);
+GList *gtk_container_get_children(GtkWidget *container);
+gboolean gtk_toggle_button_get_active(GtkWidget *button);
+gint gtk_spin_button_get_value_as_int(GtkWidget *spin);
+void gtk_label_set_text(GtkWidget *label, const gchar *str);
+void gtk_entry_set_text(GtkWidget *entry, const gchar *text);
+void gtk_entry_set_icon_from_icon_name(GtkWidget *entry, gint pos,
+                                       const gchar *icon);
+void gtk_notebook_set_tab_pos(GtkWidget *notebook, gint pos);
+void gtk_drag_source_set(GtkWidget *widget, gint mask,
+                         const GtkTargetEntry *targets, gint n, gint actions);
+void gtk_drag_dest_set(GtkWidget *widget, gint flags,
+                       const GtkTargetEntry *targets, gint n, gint actions);
+void gtk_selection_data_set(GtkSelectionData *data, gpointer type,
+                            gint format, const guchar *d, gint length);
+gpointer gtk_selection_data_get_target(GtkSelectionData *data);
+const guchar *gtk_selection_data_get_data(GtkSelectionData *data);
+
+/* gdk */
+void gdk_draw_pixmap(GdkDrawable *drawable, GdkGC *gc, GdkDrawable *src,
+                     gint xsrc, gint ysrc, gint xdest, gint ydest,
+                     gint width, gint height);
+GdkPixmap *gdk_pixmap_new(GdkDrawable *drawable, gint width, gint height,
+                          gint depth);
+GdkGC *gdk_gc_new(GdkDrawable *drawable);
+void gdk_gc_set_foreground(GdkGC *gc, const GdkColor *color);
+void gdk_draw_rectangle(GdkDrawable *drawable, GdkGC *gc, gboolean filled,
+                        gint x, gint y, gint width, gint height);
+void gdk_draw_line(GdkDrawable *drawable, GdkGC *gc,
+                   gint x1, gint y1, gint x2, gint y2);
+
+/* gkrellm */
+gint gkrellm_add_meter_style(GkrellmMonitor *mon, gchar *name);
+GkrellmStyle *gkrellm_panel_style(gint style_id);
+GkrellmStyle *gkrellm_meter_style(gint style_id);
+GkrellmTextstyle *gkrellm_meter_textstyle(gint style_id);
+GkrellmTextstyle *gkrellm_meter_alt_textstyle(gint style_id);
+GkrellmMargin *gkrellm_get_style_margins(GkrellmStyle *style);
+gint gkrellm_chart_width(void);
+GkrellmPanel *gkrellm_panel_new0(void);
+void gkrellm_panel_configure(GkrellmPanel *p, gchar *string,
+                             GkrellmStyle *style);
+void gkrellm_panel_create(GtkWidget *vbox, GkrellmMonitor *mon,
+                          GkrellmPanel *p);
+void gkrellm_panel_destroy(GkrellmPanel *p);
+GkrellmDecal *gkrellm_create_decal_text(GkrellmPanel *p, gchar *string,
+                                        GkrellmTextstyle *ts,
+                                        GkrellmStyle *style,
+                                        gint x, gint y, gint w);
+void gkrellm_draw_decal_text(GkrellmPanel *p, GkrellmDecal *d,
+                             gchar *text, gint value);
+void gkrellm_decal_text_clear(GkrellmDecal *d);
+GkrellmDecal *gkrellm_create_decal_pixmap(GkrellmPanel *p, GdkPixmap *pixmap,
+                                          GdkBitmap *mask, gint depth,
+                                          GkrellmStyle *style, gint x, gint y);
+GtkWidget *gkrellm_get_top_window(void);
+gint gkrellm_gdk_string_width(PangoFontDescription *font, gchar *string);
+void gkrellm_draw_panel_layers(GkrellmPanel *p);
+void gkrellm_disable_plugin_connect(GkrellmMonitor *mon, void (*cb)(void));
+void gkrellm_open_config_window(GkrellmMonitor *mon);
+void gkrellm_dup_string(gchar **dst, gchar *src);
+gchar *gkrellm_homedir(void);
+gchar *gkrellm_gtk_entry_get_text(GtkWidget **entry);
+GtkWidget *gkrellm_gtk_framed_notebook_page(GtkWidget *tabs, char *name);
+GtkWidget *gkrellm_gtk_framed_vbox(GtkWidget *box, gchar *label,
+                                   gint frame_border_width,
+                                   gboolean frame_expand,
+                                   gint vbox_pad, gint vbox_border_width);
+void gkrellm_gtk_check_button_connected(GtkWidget *box, GtkWidget **button,
+                                        gboolean active, gboolean expand,
+                                        gboolean fill, gint pad,
+                                        void (*cb_func)(), gpointer data,
+                                        gchar *string);
+void gkrellm_gtk_spin_button(GtkWidget *box, GtkWidget **spin_button,
+                             gfloat value, gfloat low, gfloat high,
+                             gfloat step0, gfloat step1, gint digits,
+                             gint width, void (*cb_func)(), gpointer data,
+                             gboolean right_align, gchar *string);
+
+#endif /* GKRELLM_STUB_H */
@@ -0,0 +1,571 @@
+/*****************************************************************************
+ * GKrellM nVidia                                                            *
+ * A plugin for GKrellM showing nVidia GPU info using libNVML                *
+ * Copyright (C) 2025 Carlo Casta <carlo.casta@gmail.com>                    *
+ *                                                                           *
+ * This program is free software; you can redistribute it and/or modify      *
+ * it under the terms of the GNU General Public License as published by      *
+ * the Free Software Foundation; either version 2 of the License, or         *
+ * (at your option) any later version.                                       *
+ *                                                                           *
+ * This program is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ * GNU General Public License for more details.                              *
+ *                                                                           *
+ * You should have received a copy of the GNU General Public License         *
+ * along with this program; if not, write to the Free Software               *
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA *
+ *                                                                           *
+ *****************************************************************************/
+
+/*
+ * fake libnvidia-ml exporting the subset of NVML used by the plugin.
+ * Every device returns slowly changing synthetic values; the number of
+ * GPUs and an artificial per-call latency can be set through the
+ * GKNV_MOCK_GPUS and GKNV_MOCK_LATENCY_US environment variables or the
+ * mock_nvml_set_* functions. A device can be made to fail as if it fell
+ * off the bus with mock_nvml_set_lost(). GPUs in the GKNV_MOCK_FANLESS
+ * bitmask are passively cooled and don't support fan counters. GPUs in the
+ * GKNV_MOCK_MIG bitmask (or mock_nvml_set_mig()) are split in MIG instances:
+ * a busy 3g.40gb, a 2g.20gb busy every other 15 seconds and two idle
+ * 1g.10gb, with three slots left empty. mock_nvml_set_mig_slots() creates
+ * and destroys instances (1g.10gb in the last three slots), and
+ * mock_nvml_set_mig_busy() makes the given slots busy and the rest idle.
+ */
+#include "../nvml-lib.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <stdatomic.h>
+
+#define MOCK_MAX_GPUS 64
+#define MOCK_MIG_SLOTS 7
+
+typedef struct {
+	uint id;
+	atomic_uint ticks;
+	atomic_int lost;
+} MockGpu;
+
+typedef struct {
+	MockGpu *gpu;
+	uint slot;
+} MockMig;
+
+typedef struct {
+	const char *profile;
+	uint gb;
+} MockMigLayout;
+
+static const MockMigLayout mock_mig_layout[MOCK_MIG_SLOTS] = {
+	{ "3g.40gb", 40 },
+	{ "2g.20gb", 20 },
+	{ "1g.10gb", 10 },
+	{ "1g.10gb", 10 },
+	{ "1g.10gb", 10 },
+	{ "1g.10gb", 10 },
+	{ "1g.10gb", 10 }
+};
+
+static MockGpu mock_gpus[MOCK_MAX_GPUS];
+static MockMig mock_migs[MOCK_MAX_GPUS * MOCK_MIG_SLOTS];
+static uint mock_mig = 0;
+static atomic_uint mock_mig_slots = 0x0f;
+static atomic_int mock_mig_fixed;
+static atomic_uint mock_mig_busy_slots;
+static uint mock_gpu_count = 2;
+static uint mock_latency_us = 0;
+static uint mock_fanless = 0;
+static atomic_ullong mock_calls;
+
+static uint env_uint(const char *name, uint def)
+{
+	const char *v = getenv(name);
+	return (v && *v)? (uint)strtoul(v, NULL, 10) : def;
+}
+
+static nvmlReturn_t mock_call(MockGpu *g)
+{
+	struct timespec ts;
+
+	atomic_fetch_add_explicit(&mock_calls, 1, memory_order_relaxed);
+
+	if (mock_latency_us > 0) {
+		ts.tv_sec = mock_latency_us / 1000000;
+		ts.tv_nsec = (mock_latency_us % 1000000) * 1000l;
+		nanosleep(&ts, NULL);
+	}
+
+	return (g && atomic_load(&g->lost))? NVML_ERROR_GPU_IS_LOST : NVML_SUCCESS;
+}
+
+static MockGpu *mock_gpu(nvmlDevice_t dev)
+{
+	MockGpu *g = (MockGpu*)dev;
+
+	if (g < mock_gpus || g >= mock_gpus + mock_gpu_count)
+		return NULL;
+
+	return g;
+}
+
+static MockMig *mock_mig_instance(nvmlDevice_t dev)
+{
+	MockMig *m = (MockMig*)dev;
+
+	if (m < mock_migs || m >= mock_migs + MOCK_MAX_GPUS * MOCK_MIG_SLOTS ||
+	    !m->gpu || !mock_gpu(m->gpu) || !(mock_mig & (1u << m->gpu->id)) ||
+	    !(atomic_load(&mock_mig_slots) & (1u << m->slot)))
+		return NULL;
+
+	return m;
+}
+
+static int mock_mig_busy(MockMig *m)
+{
+	if (atomic_load(&mock_mig_fixed))
+		return (atomic_load(&mock_mig_busy_slots) & (1u << m->slot)) != 0;
+
+	return m->slot == 0 || (m->slot == 1 && (time(NULL) / 15) % 2 == 0);
+}
+
+/* triangle wave in [lo, hi], different phase for every GPU */
+static uint mock_wave(MockGpu *g, uint lo, uint hi)
+{
+	uint span = hi - lo + 1;
+	uint t = atomic_fetch_add(&g->ticks, 1) + g->id * 7;
+	uint p = t % (2 * span);
+
+	return lo + ((p < span)? p : 2 * span - p - 1);
+}
+
+static void mock_busid(MockGpu *g, char *busid, uint len)
+{
+	snprintf(busid, len, "0000:%02X:00.0", g->id + 1);
+}
+
+static void mock_uuid(MockGpu *g, char *uuid, uint len)
+{
+	snprintf(uuid, len, "GPU-00000000-0000-0000-0000-%012u", g->id);
+}
+
+void mock_nvml_set_gpus(uint count)
+{
+	mock_gpu_count = (count < MOCK_MAX_GPUS)? count : MOCK_MAX_GPUS;
+}
+
+void mock_nvml_set_latency(uint us)
+{
+	mock_latency_us = us;
+}
+
+void mock_nvml_set_mig(uint gpus)
+{
+	mock_mig = gpus;
+}
+
+void mock_nvml_set_mig_slots(uint slots)
+{
+	atomic_store(&mock_mig_slots, slots);
+}
+
+void mock_nvml_set_mig_busy(uint slots)
+{
+	atomic_store(&mock_mig_busy_slots, slots);
+	atomic_store(&mock_mig_fixed, 1);
+}
+
+void mock_nvml_set_lost(uint gpu, int lost)
+{
+	if (gpu < MOCK_MAX_GPUS)
+		atomic_store(&mock_gpus[gpu].lost, lost);
+}
+
+unsigned long long mock_nvml_calls(void)
+{
+	return atomic_load(&mock_calls);
+}
+
+nvmlReturn_t nvmlInit(void)
+{
+	uint i;
+
+	for (i = 0; i < MOCK_MAX_GPUS; ++i)
+		mock_gpus[i].id = i;
+
+	for (i = 0; i < MOCK_MAX_GPUS * MOCK_MIG_SLOTS; ++i) {
+		mock_migs[i].gpu = &mock_gpus[i / MOCK_MIG_SLOTS];
+		mock_migs[i].slot = i % MOCK_MIG_SLOTS;
+	}
+
+	mock_gpu_count = env_uint("GKNV_MOCK_GPUS", mock_gpu_count);
+	mock_latency_us = env_uint("GKNV_MOCK_LATENCY_US", mock_latency_us);
+	mock_fanless = env_uint("GKNV_MOCK_FANLESS", mock_fanless);
+	mock_mig = env_uint("GKNV_MOCK_MIG", mock_mig);
+	mock_nvml_set_gpus(mock_gpu_count);
+
+	return NVML_SUCCESS;
+}
+
+nvmlReturn_t nvmlShutdown(void)
+{
+	return NVML_SUCCESS;
+}
+
+nvmlReturn_t nvmlSystemGetDriverVersion(char *version, uint len)
+{
+	snprintf(version, len, "999.99.99");
+	return mock_call(NULL);
+}
+
+nvmlReturn_t nvmlDeviceGetCount(uint *count)
+{
+	*count = mock_gpu_count;
+	return mock_call(NULL);
+}
+
+nvmlReturn_t nvmlDeviceGetHandleByIndex(uint i, nvmlDevice_t *dev)
+{
+	if (i >= mock_gpu_count)
+		return NVML_ERROR_UNKNOWN;
+
+	*dev = &mock_gpus[i];
+	return mock_call(NULL);
+}
+
+nvmlReturn_t nvmlDeviceGetName(nvmlDevice_t dev, char *name, uint len)
+{
+	MockGpu *g = mock_gpu(dev);
+	MockMig *m = mock_mig_instance(dev);
+
+	if (m) {
+		snprintf(name, len, "Mock GPU %u MIG %s",
+		         m->gpu->id,
+		         mock_mig_layout[m->slot].profile);
+		return mock_call(m->gpu);
+	}
+
+	if (!g)
+		return NVML_ERROR_UNKNOWN;
+
+	snprintf(name, len, "Mock GPU %u", g->id);
+	return mock_call(g);
+}
+
+nvmlReturn_t nvmlDeviceGetPciInfo(nvmlDevice_t dev, nvmlPciInfo_t *pci)
+{
+	MockGpu *g = mock_gpu(dev);
+
+	if (!g)
+		return NVML_ERROR_UNKNOWN;
+
+	memset(pci, 0, sizeof(*pci));
+	mock_busid(g, pci->busId, sizeof(pci->busId));
+	return mock_call(g);
+}
+
+nvmlReturn_t nvmlDeviceGetClockInfo(nvmlDevice_t dev,
+                                    nvmlClockType_t type,
+                                    uint *clock)
+{
+	MockGpu *g = mock_gpu(dev);
+
+	if (!g)
+		return NVML_ERROR_UNKNOWN;
+
+	*clock = (type == NVML_CLOCK_MEM)? 9501 : mock_wave(g, 210, 2520);
+	return mock_call(g);
+}
+
+nvmlReturn_t nvmlDeviceGetTemperature(nvmlDevice_t dev,
+                                      nvmlSensors_t sensor,
+                                      uint *temp)
+{
+	MockGpu *g = mock_gpu(dev);
+
+	(void)sensor;
+
+	if (!g)
+		return NVML_ERROR_UNKNOWN;
+
+	*temp = mock_wave(g, 30, 85);
+	return mock_call(g);
+}
+
+nvmlReturn_t nvmlDeviceGetTemperatureThreshold(nvmlDevice_t dev,
+                                               nvmlTemperatureThresholds_t type,
+                                               uint *temp)
+{
+	MockGpu *g = mock_gpu(dev);
+
+	if (!g)
+		return NVML_ERROR_UNKNOWN;
+
+	/* just above the top of the temperature wave */
+	*temp = (type == NVML_TEMPERATURE_THRESHOLD_SLOWDOWN)? 90 : 95;
+	return mock_call(g);
+}
+
+/*
+ * exported under the pre-r535 name, so the plugin goes through its
+ * fallback: idle, unrestrained, power capped, then thermal limits
+ */
+nvmlReturn_t nvmlDeviceGetCurrentClocksThrottleReasons(nvmlDevice_t dev,
+                                                       unsigned long long *reasons)
+{
+	MockGpu *g = mock_gpu(dev);
+	uint phase;
+
+	if (!g)
+		return NVML_ERROR_UNKNOWN;
+
+	phase = mock_wave(g, 0, 39);
+
+	if (phase < 10)
+		*reasons = nvmlClocksEventReasonGpuIdle;
+	else if (phase < 20)
+		*reasons = 0;
+	else if (phase < 30)
+		*reasons = nvmlClocksEventReasonSwPowerCap;
+	else if (phase < 35)
+		*reasons = nvmlClocksEventReasonSwPowerCap |
+		           nvmlClocksEventReasonSwThermalSlowdown;
+	else
+		*reasons = nvmlClocksThrottleReasonHwSlowdown;
+
+	return mock_call(g);
+}
+
+nvmlReturn_t nvmlDeviceGetFanSpeed_v2(nvmlDevice_t dev, uint fan, uint *speed)
+{
+	MockGpu *g = mock_gpu(dev);
+
+	(void)fan;
+
+	if (!g)
+		return NVML_ERROR_UNKNOWN;
+
+	if (mock_fanless & (1u << g->id))
+		return NVML_ERROR_NOT_SUPPORTED;
+
+	*speed = mock_wave(g, 30, 100);
+	return mock_call(g);
+}
+
+nvmlReturn_t nvmlDeviceGetPowerUsage(nvmlDevice_t dev, uint *mw)
+{
+	MockGpu *g = mock_gpu(dev);
+
+	if (!g)
+		return NVML_ERROR_UNKNOWN;
+
+	*mw = mock_wave(g, 15000, 450000);
+	return mock_call(g);
+}
+
+nvmlReturn_t nvmlDeviceGetUtilizationRates(nvmlDevice_t dev, nvmlUsage_t *u)
+{
+	MockGpu *g = mock_gpu(dev);
+	MockMig *m = mock_mig_instance(dev);
+
+	if (m) {
+		u->gpu = mock_mig_busy(m)? mock_wave(m->gpu, 20, 100) : 0;
+		u->memory = u->gpu / 2;
+		return mock_call(m->gpu);
+	}
+
+	if (!g)
+		return NVML_ERROR_UNKNOWN;
+
+	/* like real drivers, whole GPU utilization is gone in MIG mode */
+	if (mock_mig & (1u << g->id))
+		return NVML_ERROR_NOT_SUPPORTED;
+
+	u->gpu = mock_wave(g, 0, 100);
+	u->memory = u->gpu / 2;
+	return mock_call(g);
+}
+
+nvmlReturn_t nvmlDeviceGetMemoryInfo_v2(nvmlDevice_t dev, nvmlMemory_t *mem)
+{
+	MockGpu *g = mock_gpu(dev);
+	MockMig *m = mock_mig_instance(dev);
+
+	if (m) {
+		mem->total = (unsigned long long)mock_mig_layout[m->slot].gb << 30;
+		mem->reserved = 0;
+		mem->used = mock_mig_busy(m)? mem->total / 100 * mock_wave(m->gpu, 10, 90)
+		                            : 12ull << 20;
+		mem->free = mem->total - mem->used;
+		return mock_call(m->gpu);
+	}
+
+	if (!g)
+		return NVML_ERROR_UNKNOWN;
+
+	mem->total = 48ull << 30;
+	mem->reserved = 512ull << 20;
+	mem->used = (unsigned long long)mock_wave(g, 1, 1000) * (48ull << 20);
+	mem->free = mem->total - mem->reserved - mem->used;
+	return mock_call(g);
+}
+
+nvmlReturn_t nvmlDeviceGetMigMode(nvmlDevice_t dev, uint *current, uint *pending)
+{
+	MockGpu *g = mock_gpu(dev);
+
+	if (!g)
+		return NVML_ERROR_UNKNOWN;
+
+	*current = *pending = (mock_mig & (1u << g->id))? NVML_DEVICE_MIG_ENABLE
+	                                                : NVML_DEVICE_MIG_DISABLE;
+	return mock_call(g);
+}
+
+nvmlReturn_t nvmlDeviceGetMaxMigDeviceCount(nvmlDevice_t dev, uint *count)
+{
+	MockGpu *g = mock_gpu(dev);
+
+	if (!g)
+		return NVML_ERROR_UNKNOWN;
+
+	*count = (mock_mig & (1u << g->id))? MOCK_MIG_SLOTS : 0;
+	return mock_call(g);
+}
+
+nvmlReturn_t nvmlDeviceGetMigDeviceHandleByIndex(nvmlDevice_t dev,
+                                                 uint index,
+                                                 nvmlDevice_t *mig)
+{
+	MockGpu *g = mock_gpu(dev);
+
+	if (!g)
+		return NVML_ERROR_UNKNOWN;
+
+	if (!(mock_mig & (1u << g->id)))
+		return NVML_ERROR_NOT_SUPPORTED;
+
+	if (index >= MOCK_MIG_SLOTS || !(atomic_load(&mock_mig_slots) & (1u << index)))
+		return NVML_ERROR_NOT_FOUND;
+
+	*mig = &mock_migs[g->id * MOCK_MIG_SLOTS + index];
+	return mock_call(g);
+}
+
+nvmlReturn_t nvmlDeviceGetNumFans(nvmlDevice_t dev, uint *fans)
+{
+	MockGpu *g = mock_gpu(dev);
+
+	if (!g)
+		return NVML_ERROR_UNKNOWN;
+
+	*fans = (mock_fanless & (1u << g->id))? 0 : 1;
+	return mock_call(g);
+}
+
+nvmlReturn_t nvmlDeviceGetFanSpeedRPM(nvmlDevice_t dev, nvmlFan_t *fan)
+{
+	MockGpu *g = mock_gpu(dev);
+
+	if (!g)
+		return NVML_ERROR_UNKNOWN;
+
+	if (mock_fanless & (1u << g->id))
+		return NVML_ERROR_NOT_SUPPORTED;
+
+	fan->speed = mock_wave(g, 800, 3200);
+	return mock_call(g);
+}
+
+nvmlReturn_t nvmlDeviceGetUUID(nvmlDevice_t dev, char *uuid, uint len)
+{
+	MockGpu *g = mock_gpu(dev);
+
+	if (!g)
+		return NVML_ERROR_UNKNOWN;
+
+	mock_uuid(g, uuid, len);
+	return mock_call(g);
+}
+
+nvmlReturn_t nvmlDeviceGetHandleByPciBusId_v2(const char *busid,
+                                              nvmlDevice_t *dev)
+{
+	uint i;
+	char tmp[16];
+
+	for (i = 0; i < mock_gpu_count; ++i) {
+		mock_busid(&mock_gpus[i], tmp, sizeof(tmp));
+		if (!strcmp(tmp, busid)) {
+			*dev = &mock_gpus[i];
+			return mock_call(NULL);
+		}
+	}
+
+	return NVML_ERROR_UNKNOWN;
+}
+
+nvmlReturn_t nvmlDeviceGetHandleByUUID(const char *uuid, nvmlDevice_t *dev)
+{
+	uint i;
+	char tmp[NVML_DEVICE_UUID_BUFFER_SIZE];
+
+	for (i = 0; i < mock_gpu_count; ++i) {
+		mock_uuid(&mock_gpus[i], tmp, sizeof(tmp));
+		if (!strcmp(tmp, uuid)) {
+			*dev = &mock_gpus[i];
+			return mock_call(NULL);
+		}
+	}
+
+	return NVML_ERROR_UNKNOWN;
+}
+
+nvmlReturn_t nvmlDeviceGetPcieThroughput(nvmlDevice_t dev,
+                                         nvmlPcieUtilCounter_t counter,
+                                         uint *kbs)
+{
+	MockGpu *g = mock_gpu(dev);
+
+	if (!g)
+		return NVML_ERROR_UNKNOWN;
+
+	*kbs = (counter == NVML_PCIE_UTIL_RX_BYTES)? mock_wave(g, 0, 24000000)
+	                                           : mock_wave(g, 0, 2000000);
+	return mock_call(g);
+}
+
+nvmlReturn_t nvmlDeviceGetNvLinkState(nvmlDevice_t dev,
+                                      uint link,
+                                      nvmlEnableState_t *state)
+{
+	MockGpu *g = mock_gpu(dev);
+
+	if (!g)
+		return NVML_ERROR_UNKNOWN;
+
+	*state = (link < 4)? NVML_FEATURE_ENABLED : NVML_FEATURE_DISABLED;
+	return mock_call(g);
+}
+
+nvmlReturn_t nvmlDeviceGetFieldValues(nvmlDevice_t dev,
+                                      int count,
+                                      nvmlFieldValue_t *values)
+{
+	int i;
+	MockGpu *g = mock_gpu(dev);
+
+	if (!g)
+		return NVML_ERROR_UNKNOWN;
+
+	/* cumulative counters growing about 1 GiB/s per link */
+	for (i = 0; i < count; ++i) {
+		values[i].nvmlReturn = NVML_SUCCESS;
+		values[i].value.ullVal = (uint64)mock_wave(g, 0, 0) +
+		                         (uint64)time(NULL) * (1ull << 20);
+	}
+
+	return mock_call(g);
+}
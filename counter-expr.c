@@ -0,0 +1,221 @@
+/*****************************************************************************
+ * GKrellM nVidia                                                            *
+ * A plugin for GKrellM showing nVidia GPU info using libNVML                *
+ * Copyright (C) 2025 Carlo Casta <carlo.casta@gmail.com>                    *
+ *                                                                           *
+ * This program is free software; you can redistribute it and/or modify      *  
+ * it under the terms of the GNU General Public License as published by      *
+ * the Free Software Foundation; either version 2 of the License, or         *
+ * (at your option) any later version.                                       *
+ *                                                                           *
+ * This program is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ * GNU General Public License for more details.                              *
+ *                                                                           *
+ * You should have received a copy of the GNU General Public License         *
+ * along with this program; if not, write to the Free Software               *
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA *
+ *                                                                           *
+ *****************************************************************************/
+#include "counter-expr.h"
+#include <math.h>
+#include <string.h>
+
+/* recursive descent parser emitting postfix code */
+typedef struct {
+	const char *p;
+	const char *const *names;
+	unsigned int count;
+	CounterExpr *e;
+	unsigned int nconsts;
+	int ok;
+} ExprParser;
+
+static void skip_blanks(ExprParser *ps)
+{
+	while (*ps->p == ' ' || *ps->p == '\t')
+		++ps->p;
+}
+
+static void emit(ExprParser *ps, ExprOpcode_t op, unsigned int arg)
+{
+	if (ps->e->len == EXPR_MAX_OPS) {
+		ps->ok = 0;
+		return;
+	}
+
+	ps->e->ops[ps->e->len].op = (unsigned char)op;
+	ps->e->ops[ps->e->len].arg = (unsigned char)arg;
+	++ps->e->len;
+}
+
+static int is_name_char(char c, int first)
+{
+	return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_' ||
+	       (!first && c >= '0' && c <= '9');
+}
+
+/* by hand rather than strtod(), config files don't follow the locale */
+static void parse_number(ExprParser *ps)
+{
+	double v = 0.0, scale = 1.0;
+
+	while (*ps->p >= '0' && *ps->p <= '9')
+		v = v * 10.0 + (*ps->p++ - '0');
+
+	if (*ps->p == '.')
+		for (++ps->p; *ps->p >= '0' && *ps->p <= '9'; ++ps->p)
+			v += (*ps->p - '0') * (scale /= 10.0);
+
+	if (ps->nconsts == EXPR_MAX_CONSTS) {
+		ps->ok = 0;
+		return;
+	}
+
+	ps->e->consts[ps->nconsts] = v;
+	emit(ps, EXPR_CONST, ps->nconsts++);
+}
+
+static void parse_name(ExprParser *ps)
+{
+	unsigned int i;
+	size_t len = 0;
+
+	while (is_name_char(ps->p[len], len == 0))
+		++len;
+
+	for (i = 0; i < ps->count; ++i)
+		if (strlen(ps->names[i]) == len && !strncmp(ps->names[i], ps->p, len)) {
+			ps->p += len;
+			ps->e->vars |= 1u << i;
+			emit(ps, EXPR_VAR, i);
+			return;
+		}
+
+	ps->ok = 0;
+}
+
+static void parse_sum(ExprParser *ps);
+
+static void parse_unary(ExprParser *ps)
+{
+	skip_blanks(ps);
+
+	if (*ps->p == '-') {
+		++ps->p;
+		parse_unary(ps);
+		emit(ps, EXPR_NEG, 0);
+	} else if (*ps->p == '(') {
+		++ps->p;
+		parse_sum(ps);
+		skip_blanks(ps);
+		if (*ps->p == ')')
+			++ps->p;
+		else
+			ps->ok = 0;
+	} else if ((*ps->p >= '0' && *ps->p <= '9') || *ps->p == '.') {
+		parse_number(ps);
+	} else if (is_name_char(*ps->p, 1)) {
+		parse_name(ps);
+	} else {
+		ps->ok = 0;
+	}
+}
+
+static void parse_product(ExprParser *ps)
+{
+	char op;
+
+	parse_unary(ps);
+
+	for (skip_blanks(ps); ps->ok && (*ps->p == '*' || *ps->p == '/'); skip_blanks(ps)) {
+		op = *ps->p++;
+		parse_unary(ps);
+		emit(ps, (op == '*')? EXPR_MUL : EXPR_DIV, 0);
+	}
+}
+
+static void parse_sum(ExprParser *ps)
+{
+	char op;
+
+	parse_product(ps);
+
+	for (skip_blanks(ps); ps->ok && (*ps->p == '+' || *ps->p == '-'); skip_blanks(ps)) {
+		op = *ps->p++;
+		parse_product(ps);
+		emit(ps, (op == '+')? EXPR_ADD : EXPR_SUB, 0);
+	}
+}
+
+int counter_expr_compile(CounterExpr *e,
+                         const char *src,
+                         const char *const *names,
+                         unsigned int count)
+{
+	ExprParser ps;
+
+	memset(e, 0, sizeof(CounterExpr));
+
+	ps.p = src;
+	ps.names = names;
+	ps.count = (count > EXPR_MAX_NAMES)? EXPR_MAX_NAMES : count;
+	ps.e = e;
+	ps.nconsts = 0;
+	ps.ok = 1;
+
+	parse_sum(&ps);
+	skip_blanks(&ps);
+
+	if (!ps.ok || *ps.p != '\0') {
+		memset(e, 0, sizeof(CounterExpr));
+		return 0;
+	}
+
+	return 1;
+}
+
+int counter_expr_eval(const CounterExpr *e, const double *vars, double *result)
+{
+	double stack[EXPR_MAX_OPS];
+	unsigned int i, sp = 0;
+
+	/* a compiled program never underflows, binary ops pop two push one */
+	for (i = 0; i < e->len; ++i) {
+		switch (e->ops[i].op) {
+		case EXPR_CONST:
+			stack[sp++] = e->consts[e->ops[i].arg];
+			break;
+		case EXPR_VAR:
+			stack[sp++] = vars[e->ops[i].arg];
+			break;
+		case EXPR_NEG:
+			stack[sp - 1] = -stack[sp - 1];
+			break;
+		case EXPR_ADD:
+			--sp;
+			stack[sp - 1] += stack[sp];
+			break;
+		case EXPR_SUB:
+			--sp;
+			stack[sp - 1] -= stack[sp];
+			break;
+		case EXPR_MUL:
+			--sp;
+			stack[sp - 1] *= stack[sp];
+			break;
+		case EXPR_DIV:
+			--sp;
+			stack[sp - 1] /= stack[sp];
+			break;
+		}
+	}
+
+	if (sp != 1 || !isfinite(stack[0]))
+		return 0;
+
+	*result = stack[0];
+
+	return 1;
+}
@@ -0,0 +1,74 @@
+/*****************************************************************************
+ * GKrellM nVidia                                                            *
+ * A plugin for GKrellM showing nVidia GPU info using libNVML                *
+ * Copyright (C) 2025 Carlo Casta <carlo.casta@gmail.com>                    *
+ *                                                                           *
+ * This program is free software; you can redistribute it and/or modify      *  
+ * it under the terms of the GNU General Public License as published by      *
+ * the Free Software Foundation; either version 2 of the License, or         *
+ * (at your option) any later version.                                       *
+ *                                                                           *
+ * This program is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ * GNU General Public License for more details.                              *
+ *                                                                           *
+ * You should have received a copy of the GNU General Public License         *
+ * along with this program; if not, write to the Free Software               *
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA *
+ *                                                                           *
+ *****************************************************************************/
+#ifndef COUNTER_EXPR_H
+#define COUNTER_EXPR_H
+
+/*
+ * small arithmetic expressions over named counters, like
+ * "(total - used - reserved) / 1073741824". The source is compiled once
+ * into a postfix (RPN) program; evaluating it walks the program with a
+ * fixed stack, no parsing and no allocation per sample.
+ *
+ * grammar: numbers, names, unary minus, + - * / and parentheses
+ */
+
+#define EXPR_MAX_OPS 32
+#define EXPR_MAX_CONSTS 8
+#define EXPR_MAX_NAMES 32
+
+typedef enum {
+	EXPR_CONST,
+	EXPR_VAR,
+	EXPR_NEG,
+	EXPR_ADD,
+	EXPR_SUB,
+	EXPR_MUL,
+	EXPR_DIV
+} ExprOpcode_t;
+
+typedef struct {
+	unsigned char op;
+	unsigned char arg;   /* constant or variable index */
+} ExprOp;
+
+typedef struct {
+	ExprOp ops[EXPR_MAX_OPS];
+	double consts[EXPR_MAX_CONSTS];
+	unsigned int len;
+	unsigned int vars;   /* bitmask of the variables read */
+} CounterExpr;
+
+/*
+ * compile src, names being the variable names (at most EXPR_MAX_NAMES).
+ * Returns 0 on syntax errors, unknown names or programs too long.
+ */
+int counter_expr_compile(CounterExpr *e,
+                         const char *src,
+                         const char *const *names,
+                         unsigned int count);
+
+/*
+ * run the program, vars indexed like names (only those in e->vars are
+ * read). Returns 0 when the result is not a finite number.
+ */
+int counter_expr_eval(const CounterExpr *e, const double *vars, double *result);
+
+#endif /* COUNTER_EXPR_H */
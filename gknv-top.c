@@ -0,0 +1,342 @@
+/*****************************************************************************
+ * GKrellM nVidia                                                            *
+ * A plugin for GKrellM showing nVidia GPU info using libNVML                *
+ * Copyright (C) 2025 Carlo Casta <carlo.casta@gmail.com>                    *
+ *                                                                           *
+ * This program is free software; you can redistribute it and/or modify      *
+ * it under the terms of the GNU General Public License as published by      *
+ * the Free Software Foundation; either version 2 of the License, or         *
+ * (at your option) any later version.                                       *
+ *                                                                           *
+ * This program is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ * GNU General Public License for more details.                              *
+ *                                                                           *
+ * You should have received a copy of the GNU General Public License         *
+ * along with this program; if not, write to the Free Software               *
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA *
+ *                                                                           *
+ *****************************************************************************/
+
+/*
+ * headless consumer of the sampling core: runs the same sampling path as
+ * the plugin (worker pool, slow sampler, event listener, sample bus) and
+ * streams every published snapshot to stdout, one tab separated line per
+ * GPU. Handy to look at the plugin hot path under perf without a display.
+ * Busy MIG instances get a line of their own after their GPU, "gpu.slot"
+ * in the gpu column and only load and memory filled in.
+ *
+ * usage: gknv-top [-l libnvidia-ml.so] [-i ms] [-n samples] [-g id,...]
+ *                 [-p digits] [-r]
+ */
+#include "gpu-sampler.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifndef FALSE
+ #define FALSE (0)
+#endif
+#ifndef TRUE
+ #define TRUE (!FALSE)
+#endif
+
+#define GK_DEFAULT_LIB "libnvidia-ml.so"
+#define GK_DEFAULT_INTERVAL_MS 1000
+
+/* shared with the plugin, so both probe a device once per driver */
+#define GK_CACHE_DIR ".gkrellm2"
+
+static volatile sig_atomic_t running = 1;
+
+static void on_signal(int sig)
+{
+	(void)sig;
+	running = 0;
+}
+
+static void usage(const char *argv0)
+{
+	fprintf(stderr,
+	        "usage: %s [-l library] [-i interval ms] [-n samples] "
+	        "[-g busid|uuid,...] [-p digits] [-r]\n"
+	        "  -l  NVML library to load (default %s)\n"
+	        "  -i  sampling interval in milliseconds (default %u)\n"
+	        "  -n  stop after this many snapshots (default: run until killed)\n"
+	        "  -g  only sample these GPUs\n"
+	        "  -p  decimal digits of scaled values (default 1)\n"
+	        "  -r  raw NVML values instead of formatted ones\n",
+	        argv0,
+	        GK_DEFAULT_LIB,
+	        GK_DEFAULT_INTERVAL_MS);
+}
+
+static void select_gpus(char *ids)
+{
+	char *id;
+
+	gpu_selection_count = 0;
+
+	for (id = strtok(ids, ","); id && gpu_selection_count < GK_MAX_GPUS;
+	     id = strtok(NULL, ","))
+		snprintf(gpu_selection[gpu_selection_count++], GK_MAX_TEXT, "%s", id);
+}
+
+/* again every time instances are created or destroyed */
+static void print_mig_names(void)
+{
+	uint m;
+
+	for (m = 0; m < mig_count; ++m)
+		printf("# gpu %u.%u: %s\n", mig_info[m].gpu, mig_info[m].index, mig_info[m].name);
+}
+
+static boolean any_gpu_good(void)
+{
+	int i;
+
+	for (i = 0; i < GK_MAX_GPUS; ++i)
+		if (gpu_info[i].good)
+			return TRUE;
+
+	return FALSE;
+}
+
+static void print_header(void)
+{
+	int i, p;
+
+	for (i = 0; i < GK_MAX_GPUS; ++i)
+		if (gpu_info[i].good)
+			printf("# gpu %d: %s %s\n", i, gpu_info[i].pci.busId, gpu_info[i].name);
+
+	print_mig_names();
+
+	printf("time\tgpu");
+	for (p = GPU_NAME + 1; p < GPU_PROPS_NUM; ++p)
+		printf("\t%s", prop_key[p]);
+	printf("\ttemp/min\tpower/min\n");
+}
+
+static void print_mig_value(uint64 value, ValueUnit_t unit, uint precision, boolean raw)
+{
+	char text[GK_MAX_TEXT];
+
+	if (value == INVALID_PROP) {
+		printf("\tN/A");
+	} else if (raw) {
+		printf("\t%llu", value);
+	} else {
+		format_value(text, sizeof(text), value, unit, precision);
+		printf("\t%s", text);
+	}
+}
+
+static void print_migs(const NVSnapshot *snap, int gpu, uint precision, boolean raw)
+{
+	int p;
+	uint m;
+
+	for (m = 0; m < snap->mig_count; ++m) {
+
+		if (mig_info[m].gpu != (uint)gpu || !(snap->mig_busy & (1ull << m)))
+			continue;
+
+		printf("%llu\t%d.%u", snap->time, gpu, mig_info[m].index);
+
+		for (p = GPU_NAME + 1; p < GPU_PROPS_NUM; ++p) {
+			if (p == GPU_USAGE)
+				print_mig_value(snap->mig[m].usage, UNIT_PERCENT, precision, raw);
+			else if (p == GPU_USEDMEM)
+				print_mig_value(snap->mig[m].used, UNIT_BYTES, precision, raw);
+			else if (p == GPU_TOTALMEM)
+				print_mig_value(snap->mig[m].total, UNIT_BYTES, precision, raw);
+			else
+				printf("\t-");
+		}
+
+		printf("\t-\t-\n");
+	}
+}
+
+static void print_snapshot(const NVSnapshot *snap, uint precision, boolean raw)
+{
+	int i, p;
+	uint64 value;
+	char text[GK_MAX_TEXT];
+
+	for (i = 0; i < GK_MAX_GPUS; ++i) {
+
+		if (!(snap->fresh & GPU_BIT(i)))
+			continue;
+
+		printf("%llu\t%d", snap->time, i);
+
+		for (p = GPU_NAME + 1; p < GPU_PROPS_NUM; ++p) {
+			if (snap->lost & GPU_BIT(i))
+				printf("\tlost");
+			else if (raw && get_gpu_value(&snap->gpu[i], p, &value))
+				printf("\t%llu", value);
+			else if (!raw && format_gpu_value(&snap->gpu[i], p, text, sizeof(text), precision))
+				printf("\t%s", text);
+			else
+				printf("\tN/A");
+		}
+
+		printf("\t%+.2f\t%+.2f\n", snap->gpu[i].temp_trend, snap->gpu[i].pwr_trend);
+
+		if (!(snap->lost & GPU_BIT(i)))
+			print_migs(snap, i, precision, raw);
+	}
+}
+
+/* what kept clocks down over the whole run */
+static void print_reasons(const NVSnapshot *snap)
+{
+	int i, r;
+
+	for (i = 0; i < GK_MAX_GPUS; ++i)
+		for (r = 0; r < GK_CLOCK_REASONS; ++r)
+			if ((snap->good & GPU_BIT(i)) && snap->gpu[i].reason_seen[r])
+				printf("# gpu %d %s: %llums total, last %llums ago\n",
+				       i,
+				       clock_reason_name[r],
+				       snap->gpu[i].reason_ms[r],
+				       snap->time - snap->gpu[i].reason_seen[r]);
+}
+
+/* sleep until the next tick, ticks don't drift with the sampling time */
+static void wait_tick(struct timespec *next, uint interval_ms)
+{
+	next->tv_sec += interval_ms / 1000;
+	next->tv_nsec += (interval_ms % 1000) * 1000000l;
+	if (next->tv_nsec >= 1000000000l) {
+		++next->tv_sec;
+		next->tv_nsec -= 1000000000l;
+	}
+
+	while (running &&
+	       clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, next, NULL) != 0)
+		;
+}
+
+int main(int argc, char *argv[])
+{
+	int opt;
+	uint interval = GK_DEFAULT_INTERVAL_MS, precision = 1, mig_gen;
+	uint64 samples = 0, printed = 0;
+	boolean raw = FALSE;
+	char cache_dir[512];
+	const char *home = getenv("HOME");
+	struct sigaction sa;
+	struct timespec next;
+	SampleCursor cursor;
+	NVSnapshot snap[2];
+	const NVSnapshot *last = NULL;
+	uint s = 0;
+
+	snprintf(nvml.path, sizeof(nvml.path), "%s", GK_DEFAULT_LIB);
+
+	while ((opt = getopt(argc, argv, "l:i:n:g:p:rh")) != -1) {
+		switch (opt) {
+		case 'l':
+			snprintf(nvml.path, sizeof(nvml.path), "%s", optarg);
+			break;
+		case 'i':
+			interval = (uint)strtoul(optarg, NULL, 10);
+			break;
+		case 'n':
+			samples = strtoull(optarg, NULL, 10);
+			break;
+		case 'g':
+			select_gpus(optarg);
+			break;
+		case 'p':
+			precision = (uint)strtoul(optarg, NULL, 10);
+			if (precision > FORMAT_MAX_PRECISION)
+				precision = FORMAT_MAX_PRECISION;
+			break;
+		case 'r':
+			raw = TRUE;
+			break;
+		default:
+			usage(argv[0]);
+			return (opt == 'h')? EXIT_SUCCESS : EXIT_FAILURE;
+		}
+	}
+
+	if (interval == 0) {
+		usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = on_signal;
+	sigaction(SIGINT, &sa, NULL);
+	sigaction(SIGTERM, &sa, NULL);
+
+	init_gpu_sampler();
+
+	if (home) {
+		snprintf(cache_dir, sizeof(cache_dir), "%s/%s", home, GK_CACHE_DIR);
+		set_caps_cache_dir(cache_dir);
+	}
+
+	if (!initialize_gpulib(&nvml)) {
+		fprintf(stderr, "%s: can't load NVML from %s\n", argv[0], nvml.path);
+		return EXIT_FAILURE;
+	}
+
+	update_gpu_info();
+
+	/* nothing would ever be published, don't wait for it */
+	if (!any_gpu_good()) {
+		fprintf(stderr, "%s: no GPU found%s\n", argv[0],
+		        gpu_selection_count > 0? " matching the selection" : "");
+		shutdown_gpulib(&nvml);
+		return EXIT_FAILURE;
+	}
+
+	start_samplers();
+	attach_gpu_data(&cursor);
+
+	print_header();
+	fflush(stdout);
+	mig_gen = mig_generation;
+
+	clock_gettime(CLOCK_MONOTONIC, &next);
+
+	while (running && (samples == 0 || printed < samples)) {
+
+		update_gpu_data();
+
+		/* a failed read may leave garbage, the last good one is in the other buffer */
+		while (read_gpu_data(&cursor, &snap[s]) && (samples == 0 || printed < samples)) {
+			last = &snap[s];
+			s ^= 1;
+			if (last->mig_gen != mig_gen) {
+				print_mig_names();
+				mig_gen = last->mig_gen;
+			}
+			print_snapshot(last, precision, raw);
+			++printed;
+		}
+
+		fflush(stdout);
+
+		if (samples == 0 || printed < samples)
+			wait_tick(&next, interval);
+	}
+
+	if (last)
+		print_reasons(last);
+
+	stop_samplers();
+	shutdown_gpulib(&nvml);
+
+	return EXIT_SUCCESS;
+}
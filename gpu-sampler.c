@@ -0,0 +1,1856 @@
+/*****************************************************************************
+ * GKrellM nVidia                                                            *
+ * A plugin for GKrellM showing nVidia GPU info using libNVML                *
+ * Copyright (C) 2025 Carlo Casta <carlo.casta@gmail.com>                    *
+ *                                                                           *
+ * This program is free software; you can redistribute it and/or modify      *  
+ * it under the terms of the GNU General Public License as published by      *
+ * the Free Software Foundation; either version 2 of the License, or         *
+ * (at your option) any later version.                                       *
+ *                                                                           *
+ * This program is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ * GNU General Public License for more details.                              *
+ *                                                                           *
+ * You should have received a copy of the GNU General Public License         *
+ * along with this program; if not, write to the Free Software               *
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA *
+ *                                                                           *
+ *****************************************************************************/
+#include "gpu-sampler.h"
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#ifndef FALSE
+ #define FALSE (0)
+#endif
+#ifndef TRUE
+ #define TRUE (!FALSE)
+#endif
+
+#define MIN(a, b) (((a) < (b))? (a) : (b))
+
+#define GK_MAX_PATH 512
+
+#define GK_SLOW_PERIOD_MS 1000
+
+/* threads sampling GPUs besides the caller of update_gpu_data() */
+#ifndef GK_SAMPLER_WORKERS
+ #define GK_SAMPLER_WORKERS 3
+#endif
+
+/* event listener wakeup period */
+#define GK_EVENT_WAIT_MS 500
+
+/* failing samples in a row marking a GPU lost */
+#define GK_LOST_TICKS 3
+
+/*
+ * thermal trend: one sample a second over the last minute, a slope
+ * under 1C every 15 minutes or a slowdown more than an hour away
+ * doesn't make an estimate
+ */
+#define GK_TREND_STEP_MS 1000
+#define GK_TREND_SAMPLES 60
+#define GK_TREND_MIN_SAMPLES 10
+#define GK_TREND_MIN_SLOPE (1.0 / 900.0)
+#define GK_TREND_MAX_ETA 3600
+
+#define GK_REASON_MASK ((1u << GK_CLOCK_REASONS) - 1)
+
+/* reasons named in the formatted value, the others are counted */
+#define GK_REASONS_SHOWN 2
+
+/*
+ * idle MIG instances are looked at this often, and busy ones become idle
+ * after this long without load or allocations over GK_MIG_BUSY_BYTES
+ */
+#define GK_MIG_CHECK_MS 5000
+#define GK_MIG_IDLE_MS 10000
+#define GK_MIG_BUSY_BYTES (32ull << 20)
+
+/* slots holding an instance are looked at this often by the slow sampler */
+#define GK_MIG_SCAN_MS 5000
+
+/* per device capabilities cache, in the directory given by the caller */
+#define GK_CAPS_FILE "nvidia-caps"
+#define GK_MAX_CAPS 32
+
+/* snapshots kept by the sample bus, must be a power of two */
+#define GK_BUS_SLOTS 32
+
+#define GK_EVENT_TYPES (nvmlEventTypeClock  | \
+                        nvmlEventTypePState | \
+                        nvmlEventTypeXidCriticalError)
+
+/* convert nvml return to boolean */
+#define NVFN(fn) (nvml.fn == NVML_SUCCESS)
+
+/* same as NVFN, also accounting the result to GPU g health */
+#define NVGPU(g, fn) gpu_result((g), nvml.fn)
+
+/* mark unused variables to avoid compile warnings */
+#define UNUSED(x) (void)(x)
+
+/* helper for array length */
+#define ARRAY_SIZE(a) (sizeof(a) / sizeof(a[0]))
+
+/* helper to keep struct size consistent with enum */
+#define ASSERT_SIZE(a, sz) typedef char a ## _sz[(ARRAY_SIZE(a) == sz) - 1]
+
+GKNVMLLib nvml;
+NVGpuInfo gpu_info[GK_MAX_GPUS];
+NVAdaptiveConfig adaptive = { FALSE, 30, 5, 5, 0, 5 };
+
+char gpu_selection[GK_MAX_GPUS][GK_MAX_TEXT];
+uint gpu_selection_count = 0;
+
+NVMigInfo mig_info[GK_MAX_MIGS];
+uint mig_count = 0;
+uint mig_generation = 0;
+
+const ValueUnit_t prop_unit[] = {
+	UNIT_NONE,     /* GPU_NAME        */
+	UNIT_PERCENT,  /* GPU_USAGE       */
+	UNIT_MHZ,      /* GPU_CLOCK       */
+	UNIT_MHZ,      /* GPU_MEMCLOCK    */
+	UNIT_CELSIUS,  /* GPU_TEMP        */
+	UNIT_RPM,      /* GPU_FAN         */
+	UNIT_PERCENT,  /* GPU_FANUSAGE    */
+	UNIT_MW,       /* GPU_POWER       */
+	UNIT_PERCENT,  /* GPU_MEMUSAGE    */
+	UNIT_BYTES,    /* GPU_USEDMEM     */
+	UNIT_BYTES,    /* GPU_RESERVEDMEM */
+	UNIT_BYTES,    /* GPU_TOTALMEM    */
+	UNIT_KBPS,     /* GPU_PCIE_RX     */
+	UNIT_KBPS,     /* GPU_PCIE_TX     */
+	UNIT_KBPS,     /* GPU_NVLINK_RX   */
+	UNIT_KBPS,     /* GPU_NVLINK_TX   */
+	UNIT_SECONDS,  /* GPU_SLOWDOWN    */
+	UNIT_NONE,     /* GPU_CLOCK_REASONS */
+	UNIT_NONE      /* GPU_MIG         */
+};
+
+/* make sure this stays consistent with gpu properties */
+ASSERT_SIZE(prop_unit, GPU_PROPS_NUM);
+
+const char *const prop_key[] = {
+	"name",
+	"load",
+	"clock",
+	"memclock",
+	"temp",
+	"fan",
+	"fan_pct",
+	"power",
+	"mem_pct",
+	"used",
+	"reserved",
+	"total",
+	"pcie_rx",
+	"pcie_tx",
+	"nvlink_rx",
+	"nvlink_tx",
+	"slowdown",
+	"reasons",
+	"mig"
+};
+
+ASSERT_SIZE(prop_key, GPU_PROPS_NUM);
+
+const char *const clock_reason_name[] = {
+	"Idle",     /* GpuIdle                   */
+	"AppClk",   /* ApplicationsClocksSetting */
+	"SwPwr",    /* SwPowerCap                */
+	"HwSlow",   /* HwSlowdown                */
+	"Sync",     /* SyncBoost                 */
+	"SwThm",    /* SwThermalSlowdown         */
+	"HwThm",    /* HwThermalSlowdown         */
+	"PwrBrk",   /* HwPowerBrakeSlowdown      */
+	"Disp"      /* DisplayClockSetting       */
+};
+
+ASSERT_SIZE(clock_reason_name, GK_CLOCK_REASONS);
+
+/* reason bits, most severe first: hardware protection, then caps, then settings */
+static const uint clock_reason_severity[] = {
+	6,   /* HwThm  */
+	7,   /* PwrBrk */
+	3,   /* HwSlow */
+	5,   /* SwThm  */
+	2,   /* SwPwr  */
+	4,   /* Sync   */
+	8,   /* Disp   */
+	1,   /* AppClk */
+	0    /* Idle   */
+};
+
+ASSERT_SIZE(clock_reason_severity, GK_CLOCK_REASONS);
+
+/* GPU and MIG instance bitmasks are 64 bit wide */
+typedef char gpu_mask_sz[(GK_MAX_GPUS <= 64) - 1];
+typedef char mig_mask_sz[(GK_MAX_MIGS <= 64) - 1];
+
+/* what consumers show, read by every sampling thread */
+static atomic_uint sampled_props = ~0u;
+
+static SampleBus bus;
+static NVSnapshot bus_records[GK_BUS_SLOTS];
+static atomic_ullong bus_seq[GK_BUS_SLOTS];
+
+/*
+ * supported properties of a device as found by a given driver, in a
+ * given MIG mode: whole GPU counters go away with MIG enabled
+ */
+typedef struct _NVCapsEntry {
+	char driver[NVML_SYSTEM_DRIVER_VERSION_BUFFER_SIZE];
+	char busid[GK_MAX_TEXT];
+	char name[GK_MAX_TEXT];
+	uint mig;
+	uint caps;
+} NVCapsEntry;
+
+static NVCapsEntry caps_cache[GK_MAX_CAPS];
+static uint caps_cache_count = 0;
+static boolean caps_cache_dirty = FALSE;
+static char caps_cache_dir[GK_MAX_PATH];
+static char driver_version[NVML_SYSTEM_DRIVER_VERSION_BUFFER_SIZE];
+
+typedef struct _NVEventListener {
+	pthread_t thread;
+	nvmlEventSet_t set;
+	boolean started;
+	atomic_bool running;
+	void (*callback)(void);
+} NVEventListener;
+
+static NVEventListener listener;
+
+/*
+ * PCIe and NVLink counters are slow (PCIe blocks ~20ms) and live here,
+ * along with the lookup of quarantined devices
+ */
+typedef struct _NVSlowSampler {
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t wake;
+	boolean started;
+	boolean running;
+} NVSlowSampler;
+
+static NVSlowSampler slow_sampler = {
+	.lock = PTHREAD_MUTEX_INITIALIZER
+};
+
+/* NVML calls on different devices run concurrently, split GPUs on threads */
+typedef struct _NVSamplerPool {
+	pthread_t threads[GK_SAMPLER_WORKERS];
+	uint workers;
+	pthread_mutex_t lock;
+	pthread_cond_t start;
+	pthread_cond_t done;
+	boolean running;
+	uint64 tick;
+	uint64 now;
+	uint pending;
+	uint gpus[GK_MAX_GPUS];
+	uint gpu_count;
+} NVSamplerPool;
+
+static NVSamplerPool sampler_pool = {
+	.lock = PTHREAD_MUTEX_INITIALIZER
+};
+
+void init_gpu_sampler(void)
+{
+	sample_bus_init(&bus,
+	                bus_records,
+	                bus_seq,
+	                sizeof(NVSnapshot),
+	                GK_BUS_SLOTS);
+}
+
+void set_sampled_props(uint props)
+{
+	atomic_store(&sampled_props, props);
+}
+
+void set_caps_cache_dir(const char *dir)
+{
+	snprintf(caps_cache_dir, sizeof(caps_cache_dir), "%s", dir? dir : "");
+}
+
+void set_gpu_event_callback(void (*cb)(void))
+{
+	listener.callback = cb;
+}
+
+/* property wanted by consumers and supported by the device */
+static boolean gpu_wants(NVGpuInfo *g, GPUProperty_t prop)
+{
+	return (g->caps &
+	        atomic_load_explicit(&sampled_props, memory_order_relaxed) &
+	        (1u << prop)) != 0;
+}
+
+static uint64 monotonic_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static boolean is_uuid(const char *id)
+{
+	return !strncmp(id, "GPU-", 4) || !strncmp(id, "MIG-", 4);
+}
+
+/* find a device by PCI bus id or UUID without walking every index */
+static boolean resolve_gpu_handle(const char *id, nvmlDevice_t *h)
+{
+	uint i, gpu_count;
+	nvmlPciInfo_t pci;
+
+	if (is_uuid(id))
+		return nvml.nvmlDeviceGetHandleByUUID &&
+		       NVFN(nvmlDeviceGetHandleByUUID(id, h));
+
+	if (nvml.nvmlDeviceGetHandleByPciBusId_v2)
+		return NVFN(nvmlDeviceGetHandleByPciBusId_v2(id, h));
+
+	/* very old drivers, fall back to scanning */
+	if (NVFN(nvmlDeviceGetCount(&gpu_count)))
+		for (i = 0; i < gpu_count; ++i)
+			if (NVFN(nvmlDeviceGetHandleByIndex(i, h)) &&
+			    NVFN(nvmlDeviceGetPciInfo(*h, &pci))   &&
+			    !strcmp(pci.busId, id))
+				return TRUE;
+
+	return FALSE;
+}
+
+static boolean gpu_result(NVGpuInfo *g, nvmlReturn_t res)
+{
+	++g->calls;
+
+	if (res == NVML_SUCCESS)
+		return TRUE;
+
+	if (res == NVML_ERROR_GPU_IS_LOST)
+		g->gone = TRUE;
+
+	/* unsupported counters say nothing about the device */
+	if (res != NVML_ERROR_NOT_SUPPORTED)
+		++g->failures;
+
+	return FALSE;
+}
+
+/* turn call results of the last sample into a health state */
+static void update_gpu_health(NVGpuInfo *g)
+{
+	int health;
+
+	if (g->calls > 0 && g->failures == g->calls)
+		++g->bad_ticks;
+	else
+		g->bad_ticks = 0;
+
+	if (g->gone || g->bad_ticks >= GK_LOST_TICKS)
+		health = GPU_LOST;
+	else if (g->failures > 0)
+		health = GPU_DEGRADED;
+	else
+		health = GPU_OK;
+
+	/* make sure consumers hear about the change */
+	if (health != atomic_load(&g->health))
+		g->fresh = TRUE;
+
+	atomic_store(&g->health, health);
+
+	g->calls = g->failures = 0;
+	g->gone = FALSE;
+}
+
+/* handles of the instances on a GPU that got a new handle itself */
+static void refresh_mig_handles(NVGpuInfo *g)
+{
+	uint i, gpu = (uint)(g - gpu_info);
+
+	for (i = 0; i < mig_count; ++i)
+		if (mig_info[i].gpu == gpu &&
+		    !NVFN(nvmlDeviceGetMigDeviceHandleByIndex(g->h, mig_info[i].index, &(mig_info[i].h))))
+			mig_info[i].busy = FALSE;
+}
+
+/* pick up a handle found by the slow sampler for a lost GPU */
+static boolean adopt_recovered_gpu(NVGpuInfo *g)
+{
+	nvmlDevice_t h = atomic_exchange(&g->recovered, NULL);
+
+	if (!h)
+		return FALSE;
+
+	atomic_store(&g->h, h);
+	g->bad_ticks = 0;
+	g->stable_since = 0;
+	atomic_store(&g->dirty, ~0u);
+
+	if (listener.started && g->event_types)
+		nvml.nvmlDeviceRegisterEvents(g->h, g->event_types, listener.set);
+
+	if (g->s.mig_count > 0)
+		refresh_mig_handles(g);
+
+	atomic_store(&g->health, GPU_OK);
+
+	return TRUE;
+}
+
+static boolean caps_cache_path(char *path, int size)
+{
+	if (caps_cache_dir[0] == '\0')
+		return FALSE;
+
+	return snprintf(path, size, "%s/%s", caps_cache_dir, GK_CAPS_FILE) < size;
+}
+
+/* only entries found by the running driver are worth keeping */
+static void load_caps_cache(void)
+{
+	FILE *f;
+	NVCapsEntry *e;
+	char path[GK_MAX_PATH];
+	char line[4 * GK_MAX_TEXT];
+
+	caps_cache_count = 0;
+	caps_cache_dirty = FALSE;
+	driver_version[0] = '\0';
+
+	if (!nvml.nvmlSystemGetDriverVersion ||
+	    !NVFN(nvmlSystemGetDriverVersion(driver_version, sizeof(driver_version))))
+		driver_version[0] = '\0';
+
+	if (driver_version[0] == '\0' ||
+	    !caps_cache_path(path, sizeof(path)) ||
+	    (f = fopen(path, "r")) == NULL)
+		return;
+
+	while (caps_cache_count < GK_MAX_CAPS && fgets(line, sizeof(line), f)) {
+
+		e = &caps_cache[caps_cache_count];
+
+		if (sscanf(line, "%79[^|]|%63[^|]|%u|%x|%63[^\n]",
+		           e->driver, e->busid, &e->mig, &e->caps, e->name) == 5 &&
+		    !strcmp(e->driver, driver_version))
+			++caps_cache_count;
+	}
+
+	fclose(f);
+}
+
+static void save_caps_cache(void)
+{
+	FILE *f;
+	uint i;
+	char path[GK_MAX_PATH], tmp[GK_MAX_PATH + 4];
+
+	if (!caps_cache_dirty || !caps_cache_path(path, sizeof(path)))
+		return;
+
+	caps_cache_dirty = FALSE;
+	snprintf(tmp, sizeof(tmp), "%s.new", path);
+
+	if ((f = fopen(tmp, "w")) == NULL)
+		return;
+
+	for (i = 0; i < caps_cache_count; ++i)
+		fprintf(f, "%s|%s|%u|%x|%s\n",
+		        caps_cache[i].driver,
+		        caps_cache[i].busid,
+		        caps_cache[i].mig,
+		        caps_cache[i].caps,
+		        caps_cache[i].name);
+
+	if (fclose(f) == 0)
+		rename(tmp, path);
+	else
+		remove(tmp);
+}
+
+static boolean probe_result(nvmlReturn_t res, boolean *certain)
+{
+	if (res != NVML_SUCCESS && res != NVML_ERROR_NOT_SUPPORTED)
+		*certain = FALSE;
+
+	return res != NVML_ERROR_NOT_SUPPORTED;
+}
+
+/*
+ * active links don't mean the throughput counters are there: read both of
+ * them on the first link, each field has its own result
+ */
+static boolean probe_nvlink(NVGpuInfo *g, boolean *certain)
+{
+	nvmlFieldValue_t fv[2];
+	nvmlReturn_t res;
+	uint l;
+	int i;
+	boolean ok;
+
+	for (l = 0; l < NVML_NVLINK_MAX_LINKS; ++l)
+		if (g->nvlink_links & (1u << l))
+			break;
+
+	if (l == NVML_NVLINK_MAX_LINKS)
+		return FALSE;
+
+	memset(fv, 0, sizeof(fv));
+	fv[0].fieldId = NVML_FI_DEV_NVLINK_THROUGHPUT_DATA_RX;
+	fv[0].scopeId = l;
+	fv[1].fieldId = NVML_FI_DEV_NVLINK_THROUGHPUT_DATA_TX;
+	fv[1].scopeId = l;
+
+	res = nvml.nvmlDeviceGetFieldValues(g->h, 2, fv);
+
+	/* no per field results when the call itself failed */
+	if (res != NVML_SUCCESS)
+		return probe_result(res, certain);
+
+	for (ok = TRUE, i = 0; i < 2; ++i)
+		ok &= probe_result(fv[i].nvmlReturn, certain);
+
+	return ok;
+}
+
+/*
+ * call every counter once to find out what the device supports. Errors
+ * other than NOT_SUPPORTED leave the counter enabled but keep the result
+ * out of the cache, so it is probed again next time.
+ */
+static uint probe_gpu_caps(NVGpuInfo *g, boolean *certain)
+{
+	uint v, caps = 1u << GPU_NAME;
+	nvmlUsage_t usage;
+	nvmlMemory_t memory = { .version = nvmlMemory_ver };
+
+#define PROBE(fn, ...) (nvml.fn && probe_result(nvml.fn(__VA_ARGS__), certain))
+
+	*certain = TRUE;
+
+	if (PROBE(nvmlDeviceGetUtilizationRates, g->h, &usage))
+		caps |= (1u << GPU_USAGE) | (1u << GPU_MEMUSAGE);
+
+	if (PROBE(nvmlDeviceGetClockInfo, g->h, NVML_CLOCK_GFX, &v))
+		caps |= 1u << GPU_CLOCK;
+
+	if (PROBE(nvmlDeviceGetClockInfo, g->h, NVML_CLOCK_MEM, &v))
+		caps |= 1u << GPU_MEMCLOCK;
+
+	if (PROBE(nvmlDeviceGetTemperature, g->h, NVML_TEMP_GPU, &v))
+		caps |= 1u << GPU_TEMP;
+
+	if (g->fan_count > 0 && PROBE(nvmlDeviceGetFanSpeedRPM, g->h, &(g->fan_data[0])))
+		caps |= 1u << GPU_FAN;
+
+	if (PROBE(nvmlDeviceGetFanSpeed_v2, g->h, 0, &v))
+		caps |= 1u << GPU_FANUSAGE;
+
+	if (PROBE(nvmlDeviceGetPowerUsage, g->h, &v))
+		caps |= 1u << GPU_POWER;
+
+	if (PROBE(nvmlDeviceGetMemoryInfo_v2, g->h, &memory))
+		caps |= (1u << GPU_USEDMEM)     |
+		        (1u << GPU_RESERVEDMEM) |
+		        (1u << GPU_TOTALMEM);
+
+	/* blocks for ~20ms, one more reason to cache the result */
+	if (PROBE(nvmlDeviceGetPcieThroughput, g->h, NVML_PCIE_UTIL_RX_BYTES, &v))
+		caps |= (1u << GPU_PCIE_RX) | (1u << GPU_PCIE_TX);
+
+	if (nvml.nvmlDeviceGetFieldValues && probe_nvlink(g, certain))
+		caps |= (1u << GPU_NVLINK_RX) | (1u << GPU_NVLINK_TX);
+
+#undef PROBE
+
+	return caps;
+}
+
+static uint get_mig_mode(NVGpuInfo *g)
+{
+	uint mode, pending;
+
+	if (!nvml.nvmlDeviceGetMigMode ||
+	    !NVFN(nvmlDeviceGetMigMode(g->h, &mode, &pending)))
+		return NVML_DEVICE_MIG_DISABLE;
+
+	return mode;
+}
+
+static uint get_gpu_caps(NVGpuInfo *g)
+{
+	uint i;
+	uint caps, mig = get_mig_mode(g);
+	boolean certain;
+	NVCapsEntry *e = NULL;
+
+	for (i = 0; i < caps_cache_count; ++i)
+		if (!strcmp(caps_cache[i].busid, g->pci.busId)) {
+			e = &caps_cache[i];
+			if (!strcmp(e->name, g->name) && e->mig == mig)
+				return e->caps;
+			break;
+		}
+
+	caps = probe_gpu_caps(g, &certain);
+
+	if (!certain || driver_version[0] == '\0')
+		return caps;
+
+	/* new device, a different one in the same slot or MIG switched */
+	if (!e && caps_cache_count < GK_MAX_CAPS)
+		e = &caps_cache[caps_cache_count++];
+
+	if (e) {
+		snprintf(e->driver, sizeof(e->driver), "%s", driver_version);
+		snprintf(e->busid, GK_MAX_TEXT, "%s", g->pci.busId);
+		snprintf(e->name, GK_MAX_TEXT, "%s", g->name);
+		e->mig = mig;
+		e->caps = caps;
+		caps_cache_dirty = TRUE;
+	}
+
+	return caps;
+}
+
+static void init_gpu_info(NVGpuInfo *g)
+{
+	uint f, l;
+	uint64 reasons;
+	nvmlEnableState_t link_state;
+
+	g->good = NVFN(nvmlDeviceGetName(g->h, g->name, GK_MAX_TEXT)) &&
+	          NVFN(nvmlDeviceGetPciInfo(g->h, &(g->pci)));
+
+	g->s.memory.version = nvmlMemory_ver;
+	atomic_init(&g->dirty, ~0u);
+
+	if (nvml.nvmlDeviceGetNumFans &&
+	    NVFN(nvmlDeviceGetNumFans(g->h, &(g->fan_count))))
+		g->fan_count = MIN(g->fan_count, GK_MAX_GPU_FANS);
+	else
+		g->fan_count = 0;
+
+	for (f = 0; f < g->fan_count; ++f) {
+		g->fan_data[f].version = nvmlFan_ver;
+		g->fan_data[f].fanidx = f;
+	}
+
+	atomic_init(&g->pcie_rx, INVALID_PROP);
+	atomic_init(&g->pcie_tx, INVALID_PROP);
+	atomic_init(&g->nvlink_rx, INVALID_PROP);
+	atomic_init(&g->nvlink_tx, INVALID_PROP);
+
+	g->nvlink_links = 0;
+	if (nvml.nvmlDeviceGetNvLinkState && nvml.nvmlDeviceGetFieldValues)
+		for (l = 0; l < NVML_NVLINK_MAX_LINKS; ++l)
+			if (NVFN(nvmlDeviceGetNvLinkState(g->h, l, &link_state)) &&
+			    link_state == NVML_FEATURE_ENABLED)
+				g->nvlink_links |= 1u << l;
+
+	trend_fit_init(&g->temp_fit, GK_TREND_SAMPLES);
+	trend_fit_init(&g->pwr_fit, GK_TREND_SAMPLES);
+
+	if (!nvml.nvmlDeviceGetTemperatureThreshold ||
+	    !NVFN(nvmlDeviceGetTemperatureThreshold(g->h,
+	                                            NVML_TEMPERATURE_THRESHOLD_SLOWDOWN,
+	                                            &(g->slowdown_temp))))
+		g->slowdown_temp = 0;
+
+	if (g->good)
+		g->caps = get_gpu_caps(g);
+
+	/* read every time anyway, keep it out of the cached caps */
+	if (g->slowdown_temp > 0 && (g->caps & (1u << GPU_TEMP)))
+		g->caps |= 1u << GPU_SLOWDOWN;
+
+	/* cheap, probed here so caches written before it existed can't hide it */
+	if (g->good && nvml.nvmlDeviceGetCurrentClocksEventReasons &&
+	    NVFN(nvmlDeviceGetCurrentClocksEventReasons(g->h, &reasons)))
+		g->caps |= 1u << GPU_CLOCK_REASONS;
+}
+
+/* MIG enabled GPU, the parent keeps what it still supports */
+static void init_migs(NVGpuInfo *g)
+{
+	uint slots;
+
+	g->mig_slots = 0;
+
+	/* instance rows show at least memory, the parent must have it */
+	if (!(g->caps & (1u << GPU_USEDMEM))                              ||
+	    !nvml.nvmlDeviceGetMemoryInfo_v2                              ||
+	    !nvml.nvmlDeviceGetMaxMigDeviceCount                          ||
+	    !nvml.nvmlDeviceGetMigDeviceHandleByIndex                     ||
+	    get_mig_mode(g) != NVML_DEVICE_MIG_ENABLE                     ||
+	    !NVFN(nvmlDeviceGetMaxMigDeviceCount(g->h, &slots)))
+		return;
+
+	/* instances can be created later on, the row is there anyway */
+	g->mig_slots = MIN(slots, 32u);
+	g->caps |= 1u << GPU_MIG;
+}
+
+/* instances of g, appended to mig_info */
+static void enumerate_migs(NVGpuInfo *g, uint gpu)
+{
+	uint i, used = 0;
+	char *profile;
+	nvmlDevice_t h;
+	NVMigInfo *m;
+
+	g->s.mig_count = 0;
+
+	for (i = 0; i < g->mig_slots; ++i) {
+
+		/* empty slots have no instance */
+		if (!NVFN(nvmlDeviceGetMigDeviceHandleByIndex(g->h, i, &h)))
+			continue;
+
+		/* all of them, or the slow sampler would see a change forever */
+		used |= 1u << i;
+
+		if (mig_count == GK_MAX_MIGS)
+			continue;
+
+		m = &mig_info[mig_count];
+		memset(m, 0, sizeof(NVMigInfo));
+		m->h = h;
+
+		m->gpu = gpu;
+		m->index = i;
+		m->has_usage = (nvml.nvmlDeviceGetUtilizationRates != NULL);
+		m->memory.version = nvmlMemory_ver;
+		m->s.usage = INVALID_PROP;
+		m->s.used = m->s.total = INVALID_PROP;
+
+		/* "NVIDIA A100-SXM4-40GB MIG 1g.5gb" is shown as "1g.5gb" */
+		if (!NVFN(nvmlDeviceGetName(m->h, m->name, GK_MAX_TEXT)))
+			snprintf(m->name, GK_MAX_TEXT, "MIG %u", i);
+		else if ((profile = strstr(m->name, "MIG ")) != NULL)
+			memmove(m->name, profile + 4, strlen(profile + 4) + 1);
+
+		++mig_count;
+		++g->s.mig_count;
+	}
+
+	atomic_store(&g->mig_used, used);
+}
+
+void update_gpu_info(void)
+{
+	uint i, gpu_count;
+	nvmlDevice_t h;
+	NVGpuInfo *g;
+
+	memset(gpu_info, 0, sizeof(NVGpuInfo) * GK_MAX_GPUS);
+	mig_count = 0;
+	load_caps_cache();
+
+	/* only selected GPUs are ever touched */
+	if (gpu_selection_count > 0) {
+		for (i = 0; i < gpu_selection_count; ++i) {
+			g = &gpu_info[i];
+			if (resolve_gpu_handle(gpu_selection[i], &h)) {
+				atomic_init(&g->h, h);
+				init_gpu_info(g);
+			}
+			if (g->good) {
+				init_migs(g);
+				enumerate_migs(g, i);
+			}
+		}
+	} else if (NVFN(nvmlDeviceGetCount(&gpu_count))) {
+		for (i = 0; i < MIN(gpu_count, GK_MAX_GPUS); ++i) {
+			g = &gpu_info[i];
+			if (NVFN(nvmlDeviceGetHandleByIndex(i, &h))) {
+				atomic_init(&g->h, h);
+				init_gpu_info(g);
+			}
+			if (g->good) {
+				init_migs(g);
+				enumerate_migs(g, i);
+			}
+		}
+	}
+
+	++mig_generation;
+	save_caps_cache();
+}
+
+static boolean same_mig(const NVMigInfo *a, const NVMigInfo *b)
+{
+	return a->gpu == b->gpu && a->index == b->index && !strcmp(a->name, b->name);
+}
+
+/*
+ * instances come and go at runtime: GPUs whose instance calls failed, or
+ * whose slots in use changed under the slow sampler, get theirs listed
+ * again. This runs between ticks, when no worker touches mig_info, and
+ * instances still there keep their state.
+ */
+static void update_migs(void)
+{
+	uint i, k, m, kept, first, n = mig_count;
+	boolean rescan = FALSE, changed;
+	nvmlDevice_t h;
+	NVGpuInfo *g;
+	static NVMigInfo old[GK_MAX_MIGS];
+
+	for (i = 0; i < GK_MAX_GPUS; ++i)
+		rescan |= atomic_load_explicit(&gpu_info[i].mig_rescan, memory_order_relaxed);
+
+	if (!rescan)
+		return;
+
+	memcpy(old, mig_info, n * sizeof(NVMigInfo));
+	mig_count = 0;
+
+	for (i = 0; i < GK_MAX_GPUS; ++i) {
+
+		g = &gpu_info[i];
+
+		if (!g->good || !g->mig_slots)
+			continue;
+
+		/* lost GPUs get their handles back with the GPU */
+		if (!atomic_exchange(&g->mig_rescan, FALSE) ||
+		    atomic_load(&g->health) == GPU_LOST) {
+			for (k = 0; k < n; ++k)
+				if (old[k].gpu == i)
+					mig_info[mig_count++] = old[k];
+			continue;
+		}
+
+		first = mig_count;
+		enumerate_migs(g, i);
+
+		if (g->s.mig_busy != INVALID_PROP)
+			g->s.mig_busy = 0;
+
+		for (m = kept = first; m < mig_count; ++m) {
+			for (k = 0; k < n; ++k)
+				if (same_mig(&old[k], &mig_info[m])) {
+					h = mig_info[m].h;
+					mig_info[m] = old[k];
+					mig_info[m].h = h;
+					break;
+				}
+
+			/* still there but failing with every handle, leave it out */
+			if (mig_info[m].failures >= GK_LOST_TICKS)
+				continue;
+
+			if (g->s.mig_busy != INVALID_PROP)
+				g->s.mig_busy += mig_info[m].busy;
+
+			mig_info[kept++] = mig_info[m];
+		}
+
+		g->s.mig_count -= mig_count - kept;
+		mig_count = kept;
+
+		/* make sure consumers hear about it */
+		g->fresh = TRUE;
+	}
+
+	changed = (mig_count != n);
+	for (m = 0; !changed && m < mig_count; ++m)
+		changed = !same_mig(&old[m], &mig_info[m]);
+
+	if (changed)
+		++mig_generation;
+}
+
+static uint abs_diff(uint a, uint b)
+{
+	return (a > b)? a - b : b - a;
+}
+
+/*
+ * adaptive sampling: read only usage and power (the "sentinel" counters)
+ * and decide whether this tick needs a full sample. Idle GPUs get a full
+ * sample every idle_interval seconds, any reading over thresholds or
+ * drifting more than delta from the reference brings back full rate.
+ */
+static boolean update_gpu_activity(NVGpuInfo *g, uint64 now)
+{
+	uint pwr_w;
+	boolean active;
+
+	if (!(g->caps & (1u << GPU_USAGE)) ||
+	    !NVGPU(g, nvmlDeviceGetUtilizationRates(g->h, &(g->s.usage))))
+		g->s.usage.gpu = g->s.usage.memory = INVALID_PROP;
+
+	if (!(g->caps & (1u << GPU_POWER)) ||
+	    !NVGPU(g, nvmlDeviceGetPowerUsage(g->h, &(g->s.pwr))))
+		g->s.pwr = INVALID_PROP;
+
+	/* no sentinel available means we can't tell idle from busy */
+	if (g->s.usage.gpu == INVALID_PROP && g->s.pwr == INVALID_PROP) {
+		g->idle = FALSE;
+		return TRUE;
+	}
+
+	pwr_w = (g->s.pwr != INVALID_PROP)? g->s.pwr / 1000 : 0;
+
+	active = g->stable_since == 0 ||
+	         (g->s.usage.gpu != INVALID_PROP &&
+	          (g->s.usage.gpu >= adaptive.usage_threshold ||
+	           abs_diff(g->s.usage.gpu, g->ref_usage) > adaptive.delta)) ||
+	         (g->s.pwr != INVALID_PROP &&
+	          ((adaptive.power_threshold > 0 &&
+	            pwr_w >= adaptive.power_threshold) ||
+	           abs_diff(pwr_w, g->ref_pwr) > adaptive.delta));
+
+	if (active) {
+		g->idle = FALSE;
+		g->stable_since = now;
+		g->ref_usage = g->s.usage.gpu;
+		g->ref_pwr = pwr_w;
+		return TRUE;
+	}
+
+	if (g->idle)
+		return now - g->last_full >= adaptive.idle_interval * 1000ull;
+
+	if (now - g->stable_since >= adaptive.stable_secs * 1000ull)
+		g->idle = TRUE;
+
+	return TRUE;
+}
+
+/*
+ * copy every GPU into the next bus record. Records are complete (idle
+ * GPUs carry their last values) so consumers never have to merge them.
+ */
+static void publish_gpu_data(uint64 now)
+{
+	int i;
+	NVGpuInfo *g;
+	NVSnapshot *snap;
+	uint64 fresh = 0;
+
+	for (i = 0; i < GK_MAX_GPUS; ++i)
+		if (gpu_info[i].good && gpu_info[i].fresh)
+			fresh |= GPU_BIT(i);
+
+	/* nothing new, don't make consumers copy the same values again */
+	if (!fresh)
+		return;
+
+	snap = sample_bus_begin(&bus);
+	snap->time = now;
+	snap->good = snap->idle = snap->degraded = snap->lost = 0;
+	snap->fresh = fresh;
+
+	for (i = 0; i < GK_MAX_GPUS; ++i) {
+
+		g = &gpu_info[i];
+
+		if (!g->good)
+			continue;
+
+		g->s.pcie_rx = atomic_load(&g->pcie_rx);
+		g->s.pcie_tx = atomic_load(&g->pcie_tx);
+		g->s.nvlink_rx = atomic_load(&g->nvlink_rx);
+		g->s.nvlink_tx = atomic_load(&g->nvlink_tx);
+
+		snap->good |= GPU_BIT(i);
+		if (g->idle)
+			snap->idle |= GPU_BIT(i);
+
+		switch (atomic_load(&g->health)) {
+		case GPU_DEGRADED:
+			snap->degraded |= GPU_BIT(i);
+			break;
+		case GPU_LOST:
+			snap->lost |= GPU_BIT(i);
+			break;
+		}
+
+		snap->gpu[i] = g->s;
+	}
+
+	/* instances of GPUs not sampling them are left out */
+	snap->mig_count = mig_count;
+	snap->mig_gen = mig_generation;
+	snap->mig_busy = 0;
+
+	for (i = 0; i < (int)mig_count; ++i) {
+		g = &gpu_info[mig_info[i].gpu];
+
+		if (mig_info[i].busy && g->s.mig_busy != INVALID_PROP)
+			snap->mig_busy |= 1ull << i;
+
+		snap->mig[i] = mig_info[i].s;
+	}
+
+	sample_bus_commit(&bus);
+}
+
+/*
+ * feed temperature and power to their fits and extrapolate the time the
+ * temperature line crosses the slowdown threshold
+ */
+static void update_gpu_trend(NVGpuInfo *g, uint64 now)
+{
+	double slope, temp, eta;
+
+	if (now - g->trend_time >= GK_TREND_STEP_MS) {
+		if (g->s.temp != INVALID_PROP)
+			trend_fit_add(&g->temp_fit, now, g->s.temp);
+		if (g->s.pwr != INVALID_PROP)
+			trend_fit_add(&g->pwr_fit, now, g->s.pwr / 1000.0);
+		g->trend_time = now;
+	}
+
+	g->s.slowdown = INVALID_PROP;
+	g->s.pwr_trend = trend_fit_get(&g->pwr_fit, GK_TREND_MIN_SAMPLES, &slope, &temp)?
+	                 (float)(slope * 60.0) : 0.0f;
+
+	g->s.temp_trend = trend_fit_get(&g->temp_fit, GK_TREND_MIN_SAMPLES, &slope, &temp)?
+	                  (float)(slope * 60.0) : 0.0f;
+
+	if (g->slowdown_temp &&
+	    trend_fit_eta(&g->temp_fit, GK_TREND_MIN_SAMPLES, GK_TREND_MIN_SLOPE,
+	                  g->slowdown_temp, &eta) &&
+	    eta <= GK_TREND_MAX_ETA)
+		g->s.slowdown = (uint)eta;
+}
+
+/*
+ * time since the previous sample goes to the reasons active then. Only
+ * set bits are visited, so a GPU running unrestrained costs nothing.
+ */
+static void update_clock_reasons(NVGpuInfo *g, uint reasons, uint64 now)
+{
+	uint r, bits, active;
+	NVGpuSample *s = &g->s;
+
+	if (s->reasons != INVALID_PROP)
+		for (bits = s->reasons; bits; bits &= bits - 1)
+			s->reason_ms[__builtin_ctz(bits)] += now - g->reason_time;
+
+	active = (reasons != INVALID_PROP)? reasons : 0;
+
+	for (bits = active; bits; bits &= bits - 1)
+		s->reason_seen[__builtin_ctz(bits)] = now;
+
+	s->recent_reasons |= active;
+
+	for (bits = s->recent_reasons & ~active; bits; bits &= bits - 1) {
+		r = __builtin_ctz(bits);
+		if (now - s->reason_seen[r] >= GK_REASON_STICKY_MS)
+			s->recent_reasons &= ~(1u << r);
+	}
+
+	s->reasons = reasons;
+	g->reason_time = now;
+}
+
+/*
+ * instance calls say nothing about the parent, its health is left alone.
+ * A failing instance was destroyed or has a stale handle: instances are
+ * listed again, the failure count is kept apart.
+ */
+static boolean mig_result(NVGpuInfo *g, NVMigInfo *m, nvmlReturn_t res)
+{
+	if (res == NVML_SUCCESS) {
+		m->failures = 0;
+		return TRUE;
+	}
+
+	if (res != NVML_ERROR_NOT_SUPPORTED) {
+		++m->failures;
+		m->busy = FALSE;
+		atomic_store(&g->mig_rescan, TRUE);
+	}
+
+	return FALSE;
+}
+
+/*
+ * busy instances are sampled on every tick, idle ones only every
+ * GK_MIG_CHECK_MS to notice when they get some work
+ */
+static void sample_migs(NVGpuInfo *g, uint64 now)
+{
+	uint i, busy = 0, gpu = (uint)(g - gpu_info);
+	boolean active;
+	nvmlReturn_t res;
+	nvmlUsage_t usage;
+	NVMigInfo *m;
+
+	for (i = 0; i < mig_count; ++i) {
+
+		m = &mig_info[i];
+
+		if (m->gpu != gpu || (!m->busy && now < m->next_check))
+			continue;
+
+		m->next_check = now + GK_MIG_CHECK_MS;
+
+		res = nvml.nvmlDeviceGetMemoryInfo_v2?
+		      nvml.nvmlDeviceGetMemoryInfo_v2(m->h, &(m->memory)) : NVML_ERROR_NOT_SUPPORTED;
+
+		if (mig_result(g, m, res)) {
+			m->s.used = m->memory.used;
+			m->s.total = m->memory.total;
+		} else {
+			m->s.used = m->s.total = INVALID_PROP;
+		}
+
+		/* nothing more until listed again */
+		if (m->failures > 0)
+			continue;
+
+		/* most drivers only report utilization of whole GPUs */
+		m->s.usage = INVALID_PROP;
+		if (m->has_usage && nvml.nvmlDeviceGetUtilizationRates) {
+			res = nvml.nvmlDeviceGetUtilizationRates(m->h, &usage);
+			if (res == NVML_ERROR_NOT_SUPPORTED)
+				m->has_usage = FALSE;
+			else if (mig_result(g, m, res))
+				m->s.usage = usage.gpu;
+		}
+
+		active = (m->s.usage != INVALID_PROP && m->s.usage > 0) ||
+		         (m->s.used != INVALID_PROP && m->s.used > GK_MIG_BUSY_BYTES);
+
+		if (active) {
+			m->busy = TRUE;
+			m->last_active = now;
+		} else if (m->busy && now - m->last_active >= GK_MIG_IDLE_MS) {
+			m->busy = FALSE;
+		}
+
+		busy += m->busy;
+	}
+
+	g->s.mig_busy = busy;
+}
+
+static void sample_gpu(NVGpuInfo *g, uint64 now)
+{
+	uint dirty;
+	uint64 reasons;
+	boolean clock_polled;
+
+	/* lost GPUs stay out until they get a new handle */
+	if (atomic_load(&g->health) == GPU_LOST && !adopt_recovered_gpu(g)) {
+		g->fresh = FALSE;
+		return;
+	}
+
+	if (adaptive.enable) {
+		g->fresh = update_gpu_activity(g, now);
+		if (!g->fresh) {
+			update_gpu_health(g);
+			return;
+		}
+	} else {
+		g->fresh = TRUE;
+		g->idle = FALSE;
+	}
+
+	g->last_full = now;
+	dirty = atomic_exchange(&g->dirty, 0);
+
+	/* with clock events registered clocks are read only when changed */
+	clock_polled = !(g->event_types & nvmlEventTypeClock);
+
+	if (clock_polled || (dirty & (1u << GPU_CLOCK)))
+		if (!gpu_wants(g, GPU_CLOCK) ||
+		    !NVGPU(g, nvmlDeviceGetClockInfo(g->h, NVML_CLOCK_GFX, &(g->s.clock))))
+			g->s.clock = INVALID_PROP;
+
+	if (clock_polled || (dirty & (1u << GPU_MEMCLOCK)))
+		if (!gpu_wants(g, GPU_MEMCLOCK) ||
+		    !NVGPU(g, nvmlDeviceGetClockInfo(g->h, NVML_CLOCK_MEM, &(g->s.memclock))))
+			g->s.memclock = INVALID_PROP;
+
+	if ((!gpu_wants(g, GPU_TEMP) && !gpu_wants(g, GPU_SLOWDOWN)) ||
+	    !NVGPU(g, nvmlDeviceGetTemperature(g->h, NVML_TEMP_GPU, &(g->s.temp))))
+		g->s.temp = INVALID_PROP;
+
+	if (!gpu_wants(g, GPU_FANUSAGE) ||
+	    !NVGPU(g, nvmlDeviceGetFanSpeed_v2(g->h, 0, &(g->s.fan))))
+		g->s.fan = INVALID_PROP;
+
+	if (gpu_wants(g, GPU_FAN) &&
+	    NVGPU(g, nvmlDeviceGetFanSpeedRPM(g->h, &(g->fan_data[0]))))
+		g->s.fan_rpm = g->fan_data[0].speed;
+	else
+		g->s.fan_rpm = INVALID_PROP;
+
+	/* usage and power were already read by the adaptive sentinel */
+	if (!adaptive.enable) {
+		if (!gpu_wants(g, GPU_POWER) ||
+		    !NVGPU(g, nvmlDeviceGetPowerUsage(g->h, &(g->s.pwr))))
+			g->s.pwr = INVALID_PROP;
+
+		if ((!gpu_wants(g, GPU_USAGE) &&
+		     !gpu_wants(g, GPU_MEMUSAGE)) ||
+		    !NVGPU(g, nvmlDeviceGetUtilizationRates(g->h, &(g->s.usage))))
+			g->s.usage.gpu = g->s.usage.memory = INVALID_PROP;
+	}
+
+	if ((!gpu_wants(g, GPU_USEDMEM) &&
+	     !gpu_wants(g, GPU_RESERVEDMEM) &&
+	     !gpu_wants(g, GPU_TOTALMEM)) ||
+	     !NVGPU(g, nvmlDeviceGetMemoryInfo_v2(g->h, &(g->s.memory))))
+		g->s.memory.free =
+		g->s.memory.reserved =
+		g->s.memory.total =
+		g->s.memory.used = INVALID_PROP;
+
+	if (gpu_wants(g, GPU_CLOCK_REASONS) &&
+	    NVGPU(g, nvmlDeviceGetCurrentClocksEventReasons(g->h, &reasons)))
+		update_clock_reasons(g, (uint)(reasons & GK_REASON_MASK), now);
+	else
+		update_clock_reasons(g, INVALID_PROP, now);
+
+	if (gpu_wants(g, GPU_MIG))
+		sample_migs(g, now);
+	else
+		g->s.mig_busy = INVALID_PROP;
+
+	update_gpu_trend(g, now);
+	update_gpu_health(g);
+}
+
+/* GPUs are dealt round robin to the main loop thread (share 0) and workers */
+static void sample_gpu_share(uint share, uint64 now)
+{
+	uint i;
+
+	for (i = share; i < sampler_pool.gpu_count; i += sampler_pool.workers + 1)
+		sample_gpu(&gpu_info[sampler_pool.gpus[i]], now);
+}
+
+/*
+ * a full sample of g is coming this tick. Lost GPUs without a new
+ * handle, GPUs with nothing to read and idle GPUs between full samples
+ * only cost a few calls (or none), not worth waking a worker for.
+ */
+static boolean gpu_due(NVGpuInfo *g, uint64 now)
+{
+	uint props = atomic_load_explicit(&sampled_props, memory_order_relaxed);
+
+	if (atomic_load(&g->health) == GPU_LOST)
+		return atomic_load(&g->recovered) != NULL;
+
+	if (!(g->caps & props & ~(1u << GPU_NAME) & ~GK_SLOW_PROPS))
+		return FALSE;
+
+	if (adaptive.enable && g->idle)
+		return now - g->last_full >= adaptive.idle_interval * 1000ull;
+
+	return TRUE;
+}
+
+/* worker thread, samples its own share of GPUs every time it's woken up */
+static void *sampler_worker(void *data)
+{
+	uint share = (uint)(long)data;
+	uint64 seen = 0, now;
+
+	pthread_mutex_lock(&sampler_pool.lock);
+
+	for (;;) {
+
+		while (sampler_pool.running && sampler_pool.tick == seen)
+			pthread_cond_wait(&sampler_pool.start, &sampler_pool.lock);
+
+		if (!sampler_pool.running)
+			break;
+
+		seen = sampler_pool.tick;
+		now = sampler_pool.now;
+
+		pthread_mutex_unlock(&sampler_pool.lock);
+		sample_gpu_share(share, now);
+		pthread_mutex_lock(&sampler_pool.lock);
+
+		if (--sampler_pool.pending == 0)
+			pthread_cond_signal(&sampler_pool.done);
+	}
+
+	pthread_mutex_unlock(&sampler_pool.lock);
+
+	return NULL;
+}
+
+static void start_sampler_pool(void)
+{
+	uint i, workers;
+
+	sampler_pool.gpu_count = 0;
+	for (i = 0; i < GK_MAX_GPUS; ++i)
+		if (gpu_info[i].good)
+			sampler_pool.gpus[sampler_pool.gpu_count++] = i;
+
+	/* the main loop thread samples a share too */
+	workers = MIN(sampler_pool.gpu_count, GK_SAMPLER_WORKERS + 1) - 1;
+	if (sampler_pool.gpu_count == 0 || workers == 0)
+		return;
+
+	pthread_cond_init(&sampler_pool.start, NULL);
+	pthread_cond_init(&sampler_pool.done, NULL);
+	sampler_pool.running = TRUE;
+	sampler_pool.tick = 0;
+
+	for (i = 0; i < workers; ++i)
+		if (pthread_create(&sampler_pool.threads[i],
+		                   NULL,
+		                   sampler_worker,
+		                   (void*)(long)(i + 1)) != 0)
+			break;
+
+	sampler_pool.workers = i;
+}
+
+static void stop_sampler_pool(void)
+{
+	uint i;
+
+	sampler_pool.gpu_count = 0;
+
+	if (sampler_pool.workers == 0)
+		return;
+
+	pthread_mutex_lock(&sampler_pool.lock);
+	sampler_pool.running = FALSE;
+	pthread_cond_broadcast(&sampler_pool.start);
+	pthread_mutex_unlock(&sampler_pool.lock);
+
+	for (i = 0; i < sampler_pool.workers; ++i)
+		pthread_join(sampler_pool.threads[i], NULL);
+
+	pthread_cond_destroy(&sampler_pool.start);
+	pthread_cond_destroy(&sampler_pool.done);
+
+	sampler_pool.workers = 0;
+}
+
+void update_gpu_data(void)
+{
+	uint i, due = 0;
+	uint64 now = monotonic_ms();
+
+	for (i = 0; i < sampler_pool.gpu_count && due < 2; ++i)
+		due += gpu_due(&gpu_info[sampler_pool.gpus[i]], now);
+
+	/* the handoff costs more than a single GPU sample */
+	if (sampler_pool.workers == 0 || due < 2) {
+		for (i = 0; i < sampler_pool.gpu_count; ++i)
+			sample_gpu(&gpu_info[sampler_pool.gpus[i]], now);
+	} else {
+		pthread_mutex_lock(&sampler_pool.lock);
+		sampler_pool.now = now;
+		sampler_pool.pending = sampler_pool.workers;
+		++sampler_pool.tick;
+		pthread_cond_broadcast(&sampler_pool.start);
+		pthread_mutex_unlock(&sampler_pool.lock);
+
+		sample_gpu_share(0, now);
+
+		/* every device is done before the snapshot goes out */
+		pthread_mutex_lock(&sampler_pool.lock);
+		while (sampler_pool.pending > 0)
+			pthread_cond_wait(&sampler_pool.done, &sampler_pool.lock);
+		pthread_mutex_unlock(&sampler_pool.lock);
+	}
+
+	update_migs();
+	publish_gpu_data(now);
+}
+
+static void sample_pcie(NVGpuInfo *g, uint props)
+{
+	uint kbs;
+
+	if (!nvml.nvmlDeviceGetPcieThroughput)
+		return;
+
+	if (props & (1u << GPU_PCIE_RX))
+		atomic_store(&g->pcie_rx,
+		             NVFN(nvmlDeviceGetPcieThroughput(g->h,
+		                                              NVML_PCIE_UTIL_RX_BYTES,
+		                                              &kbs))? kbs : INVALID_PROP);
+
+	if (props & (1u << GPU_PCIE_TX))
+		atomic_store(&g->pcie_tx,
+		             NVFN(nvmlDeviceGetPcieThroughput(g->h,
+		                                              NVML_PCIE_UTIL_TX_BYTES,
+		                                              &kbs))? kbs : INVALID_PROP);
+}
+
+/* NVLink counters are cumulative per link, rates come from deltas */
+static void sample_nvlink(NVGpuInfo *g, uint64 now)
+{
+	nvmlFieldValue_t fv[2 * NVML_NVLINK_MAX_LINKS];
+	uint64 rx = 0, tx = 0, dt;
+	int n = 0, i;
+	uint l;
+	boolean ok = TRUE;
+
+	for (l = 0; l < NVML_NVLINK_MAX_LINKS; ++l)
+		if (g->nvlink_links & (1u << l)) {
+			memset(&fv[n], 0, 2 * sizeof(nvmlFieldValue_t));
+			fv[n].fieldId = NVML_FI_DEV_NVLINK_THROUGHPUT_DATA_RX;
+			fv[n++].scopeId = l;
+			fv[n].fieldId = NVML_FI_DEV_NVLINK_THROUGHPUT_DATA_TX;
+			fv[n++].scopeId = l;
+		}
+
+	/* one call for every link */
+	if (!NVFN(nvmlDeviceGetFieldValues(g->h, n, fv)))
+		ok = FALSE;
+
+	for (i = 0; ok && i < n; ++i) {
+		if (fv[i].nvmlReturn != NVML_SUCCESS)
+			ok = FALSE;
+		else if (fv[i].fieldId == NVML_FI_DEV_NVLINK_THROUGHPUT_DATA_RX)
+			rx += fv[i].value.ullVal;
+		else
+			tx += fv[i].value.ullVal;
+	}
+
+	if (!ok) {
+		g->nvlink_time = 0;
+		atomic_store(&g->nvlink_rx, INVALID_PROP);
+		atomic_store(&g->nvlink_tx, INVALID_PROP);
+		return;
+	}
+
+	dt = now - g->nvlink_time;
+	if (g->nvlink_time && dt > 0 && rx >= g->nvlink_rx_kib && tx >= g->nvlink_tx_kib) {
+		atomic_store(&g->nvlink_rx, (uint)((rx - g->nvlink_rx_kib) * 1000 / dt));
+		atomic_store(&g->nvlink_tx, (uint)((tx - g->nvlink_tx_kib) * 1000 / dt));
+	}
+
+	g->nvlink_rx_kib = rx;
+	g->nvlink_tx_kib = tx;
+	g->nvlink_time = now;
+}
+
+/* instances created or destroyed since they were listed, no state touched here */
+static void scan_mig_slots(NVGpuInfo *g, uint64 now)
+{
+	uint i, used = 0;
+	nvmlDevice_t h;
+
+	if (now < g->next_mig_scan)
+		return;
+
+	g->next_mig_scan = now + GK_MIG_SCAN_MS;
+
+	for (i = 0; i < g->mig_slots; ++i)
+		if (NVFN(nvmlDeviceGetMigDeviceHandleByIndex(g->h, i, &h)))
+			used |= 1u << i;
+
+	if (used != atomic_load(&g->mig_used))
+		atomic_store(&g->mig_rescan, TRUE);
+}
+
+/* quarantined devices get a new handle looked up by bus id from time to time */
+static void recover_gpu(NVGpuInfo *g, uint64 now)
+{
+	nvmlDevice_t h;
+	uint temp;
+	nvmlReturn_t res;
+
+	if (now < g->next_probe || atomic_load(&g->recovered))
+		return;
+
+	g->next_probe = now + GK_RECOVER_PERIOD_MS;
+
+	if (!resolve_gpu_handle(g->pci.busId, &h))
+		return;
+
+	/* handles of a lost GPU are still returned, make sure it answers */
+	res = nvml.nvmlDeviceGetTemperature?
+	      nvml.nvmlDeviceGetTemperature(h, NVML_TEMP_GPU, &temp) : NVML_SUCCESS;
+	if (res == NVML_SUCCESS || res == NVML_ERROR_NOT_SUPPORTED)
+		atomic_store(&g->recovered, h);
+}
+
+static void *slow_sampler_thread(void *data)
+{
+	int i;
+	uint props;
+	NVGpuInfo *g;
+	struct timespec deadline;
+
+	UNUSED(data);
+
+	pthread_mutex_lock(&slow_sampler.lock);
+
+	while (slow_sampler.running) {
+
+		pthread_mutex_unlock(&slow_sampler.lock);
+
+		for (i = 0; i < GK_MAX_GPUS; ++i) {
+
+			g = &gpu_info[i];
+
+			if (!g->good)
+				continue;
+
+			if (atomic_load(&g->health) == GPU_LOST) {
+				recover_gpu(g, monotonic_ms());
+				continue;
+			}
+
+			props = atomic_load(&sampled_props) & g->caps;
+
+			if (props & ((1u << GPU_PCIE_RX) | (1u << GPU_PCIE_TX)))
+				sample_pcie(g, props);
+
+			if (g->nvlink_links &&
+			    (props & ((1u << GPU_NVLINK_RX) | (1u << GPU_NVLINK_TX))))
+				sample_nvlink(g, monotonic_ms());
+
+			if (g->mig_slots && (props & (1u << GPU_MIG)))
+				scan_mig_slots(g, monotonic_ms());
+		}
+
+		clock_gettime(CLOCK_MONOTONIC, &deadline);
+		deadline.tv_sec += GK_SLOW_PERIOD_MS / 1000;
+		deadline.tv_nsec += (GK_SLOW_PERIOD_MS % 1000) * 1000000l;
+		if (deadline.tv_nsec >= 1000000000l) {
+			++deadline.tv_sec;
+			deadline.tv_nsec -= 1000000000l;
+		}
+
+		pthread_mutex_lock(&slow_sampler.lock);
+		while (slow_sampler.running &&
+		       pthread_cond_timedwait(&slow_sampler.wake,
+		                              &slow_sampler.lock,
+		                              &deadline) == 0)
+			;
+	}
+
+	pthread_mutex_unlock(&slow_sampler.lock);
+
+	return NULL;
+}
+
+static void start_slow_sampler(void)
+{
+	pthread_condattr_t attr;
+
+	if (slow_sampler.started)
+		return;
+
+	pthread_condattr_init(&attr);
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+	pthread_cond_init(&slow_sampler.wake, &attr);
+	pthread_condattr_destroy(&attr);
+
+	slow_sampler.running = TRUE;
+	slow_sampler.started = (pthread_create(&slow_sampler.thread,
+	                                       NULL,
+	                                       slow_sampler_thread,
+	                                       NULL) == 0);
+
+	if (!slow_sampler.started)
+		pthread_cond_destroy(&slow_sampler.wake);
+}
+
+static void stop_slow_sampler(void)
+{
+	if (!slow_sampler.started)
+		return;
+
+	pthread_mutex_lock(&slow_sampler.lock);
+	slow_sampler.running = FALSE;
+	pthread_cond_signal(&slow_sampler.wake);
+	pthread_mutex_unlock(&slow_sampler.lock);
+
+	pthread_join(slow_sampler.thread, NULL);
+	pthread_cond_destroy(&slow_sampler.wake);
+
+	slow_sampler.started = FALSE;
+}
+
+static void *event_listener(void *data)
+{
+	int i;
+	NVGpuInfo *g;
+	nvmlEventData_t ev;
+	nvmlReturn_t res;
+	uint dirty;
+	struct timespec backoff = { 0, GK_EVENT_WAIT_MS * 1000000l };
+
+	UNUSED(data);
+
+	while (atomic_load(&listener.running)) {
+
+		memset(&ev, 0, sizeof(ev));
+		res = nvml.nvmlEventSetWait_v2(listener.set, &ev, GK_EVENT_WAIT_MS);
+
+		if (res == NVML_ERROR_TIMEOUT)
+			continue;
+
+		/* don't spin on persistent errors (e.g. a lost GPU) */
+		if (res != NVML_SUCCESS) {
+			nanosleep(&backoff, NULL);
+			continue;
+		}
+
+		for (i = 0; i < GK_MAX_GPUS; ++i) {
+
+			g = &gpu_info[i];
+
+			if (!g->good || atomic_load(&g->h) != ev.device)
+				continue;
+
+			dirty = 0;
+			if (ev.eventType & (nvmlEventTypeClock | nvmlEventTypePState))
+				dirty |= (1u << GPU_CLOCK) | (1u << GPU_MEMCLOCK);
+
+			if (ev.eventType & nvmlEventTypeXidCriticalError)
+				atomic_store(&g->xid, ev.eventData);
+
+			atomic_fetch_or(&g->dirty, dirty);
+			atomic_fetch_or(&g->pending, ev.eventType);
+
+			if (listener.callback)
+				listener.callback();
+		}
+	}
+
+	return NULL;
+}
+
+static void start_event_listener(void)
+{
+	int i;
+	uint64 types;
+	boolean registered = FALSE;
+	NVGpuInfo *g;
+
+	if (listener.started ||
+	    !has_gpulib_events(&nvml) ||
+	    !NVFN(nvmlEventSetCreate(&listener.set)))
+		return;
+
+	for (i = 0; i < GK_MAX_GPUS; ++i) {
+
+		g = &gpu_info[i];
+
+		if (!g->good ||
+		    !NVFN(nvmlDeviceGetSupportedEventTypes(g->h, &types)))
+			continue;
+
+		types &= GK_EVENT_TYPES;
+
+		if (types && NVFN(nvmlDeviceRegisterEvents(g->h, types, listener.set))) {
+			g->event_types = types;
+			registered = TRUE;
+		}
+	}
+
+	atomic_store(&listener.running, registered);
+
+	if (registered &&
+	    pthread_create(&listener.thread, NULL, event_listener, NULL) == 0) {
+		listener.started = TRUE;
+		return;
+	}
+
+	/* nothing to listen for, go back to plain polling */
+	atomic_store(&listener.running, FALSE);
+	for (i = 0; i < GK_MAX_GPUS; ++i)
+		gpu_info[i].event_types = 0;
+
+	nvml.nvmlEventSetFree(listener.set);
+}
+
+static void stop_event_listener(void)
+{
+	if (!listener.started)
+		return;
+
+	atomic_store(&listener.running, FALSE);
+	pthread_join(listener.thread, NULL);
+	nvml.nvmlEventSetFree(listener.set);
+
+	listener.started = FALSE;
+}
+
+void start_samplers(void)
+{
+	start_event_listener();
+	start_slow_sampler();
+	start_sampler_pool();
+}
+
+void stop_samplers(void)
+{
+	stop_sampler_pool();
+	stop_slow_sampler();
+	stop_event_listener();
+}
+
+boolean get_gpu_value(const NVGpuSample *s, int prop, uint64 *value)
+{
+	switch (prop) {
+	case GPU_CLOCK:
+		*value = s->clock;
+		return s->clock != INVALID_PROP;
+
+	case GPU_MEMCLOCK:
+		*value = s->memclock;
+		return s->memclock != INVALID_PROP;
+
+	case GPU_TEMP:
+		*value = s->temp;
+		return s->temp != INVALID_PROP;
+
+	case GPU_FANUSAGE:
+		*value = MIN(s->fan, 100u);
+		return s->fan != INVALID_PROP;
+
+	case GPU_FAN:
+		*value = s->fan_rpm;
+		return s->fan_rpm != INVALID_PROP;
+
+	case GPU_POWER:
+		*value = s->pwr;
+		return s->pwr != INVALID_PROP;
+
+	case GPU_USAGE:
+		*value = s->usage.gpu;
+		return s->usage.gpu != INVALID_PROP;
+
+	case GPU_MEMUSAGE:
+		*value = s->usage.memory;
+		return s->usage.memory != INVALID_PROP;
+
+	case GPU_USEDMEM:
+		*value = s->memory.used;
+		return s->memory.used != INVALID_PROP;
+
+	case GPU_RESERVEDMEM:
+		*value = s->memory.reserved;
+		return s->memory.reserved != INVALID_PROP;
+
+	case GPU_TOTALMEM:
+		*value = s->memory.total;
+		return s->memory.total != INVALID_PROP;
+
+	case GPU_PCIE_RX:
+		*value = s->pcie_rx;
+		return s->pcie_rx != INVALID_PROP;
+
+	case GPU_PCIE_TX:
+		*value = s->pcie_tx;
+		return s->pcie_tx != INVALID_PROP;
+
+	case GPU_NVLINK_RX:
+		*value = s->nvlink_rx;
+		return s->nvlink_rx != INVALID_PROP;
+
+	case GPU_NVLINK_TX:
+		*value = s->nvlink_tx;
+		return s->nvlink_tx != INVALID_PROP;
+
+	case GPU_SLOWDOWN:
+		*value = s->slowdown;
+		return s->slowdown != INVALID_PROP;
+
+	case GPU_CLOCK_REASONS:
+		*value = s->reasons;
+		return s->reasons != INVALID_PROP;
+
+	case GPU_MIG:
+		*value = s->mig_busy;
+		return s->mig_busy != INVALID_PROP;
+
+	default:
+		return FALSE;
+	}
+}
+
+/* most severe first, those ended but still recent in parentheses */
+static void format_clock_reasons(const NVGpuSample *s, char *buf, int buf_size)
+{
+	int i, len = 0, shown = 0, more = 0;
+	uint r, bit, all = s->reasons | s->recent_reasons;
+
+	for (i = 0; i < GK_CLOCK_REASONS; ++i) {
+
+		r = clock_reason_severity[i];
+		bit = 1u << r;
+
+		if (!(all & bit))
+			continue;
+
+		if (shown == GK_REASONS_SHOWN || len >= buf_size) {
+			++more;
+			continue;
+		}
+
+		len += snprintf(buf + len, buf_size - len,
+		                (s->reasons & bit)? "%s%s" : "%s(%s)",
+		                shown? " " : "",
+		                clock_reason_name[r]);
+		++shown;
+	}
+
+	if (more && len < buf_size)
+		snprintf(buf + len, buf_size - len, " +%d", more);
+	else if (!shown)
+		snprintf(buf, buf_size, "None");
+}
+
+boolean format_gpu_value(const NVGpuSample *s,
+                         int prop,
+                         char *buf,
+                         int buf_size,
+                         uint precision)
+{
+	uint64 value;
+
+	if (!get_gpu_value(s, prop, &value))
+		return FALSE;
+
+	if (prop == GPU_CLOCK_REASONS)
+		format_clock_reasons(s, buf, buf_size);
+	else if (prop == GPU_MIG)
+		snprintf(buf, buf_size, "%u/%u", s->mig_busy, s->mig_count);
+	else
+		format_value(buf, buf_size, value, prop_unit[prop], precision);
+
+	return TRUE;
+}
+
+void attach_gpu_data(SampleCursor *cursor)
+{
+	sample_bus_attach(&bus, cursor);
+}
+
+boolean read_gpu_data(SampleCursor *cursor, NVSnapshot *snap)
+{
+	return sample_bus_read(&bus, cursor, snap);
+}
@@ -0,0 +1,272 @@
+/*****************************************************************************
+ * GKrellM nVidia                                                            *
+ * A plugin for GKrellM showing nVidia GPU info using libNVML                *
+ * Copyright (C) 2025 Carlo Casta <carlo.casta@gmail.com>                    *
+ *                                                                           *
+ * This program is free software; you can redistribute it and/or modify      *
+ * it under the terms of the GNU General Public License as published by      *
+ * the Free Software Foundation; either version 2 of the License, or         *
+ * (at your option) any later version.                                       *
+ *                                                                           *
+ * This program is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ * GNU General Public License for more details.                              *
+ *                                                                           *
+ * You should have received a copy of the GNU General Public License         *
+ * along with this program; if not, write to the Free Software               *
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA *
+ *                                                                           *
+ *****************************************************************************/
+#ifndef GPU_SAMPLER_H
+#define GPU_SAMPLER_H
+
+#include <stdatomic.h>
+#include "nvml-lib.h"
+#include "value-format.h"
+#include "sample-bus.h"
+#include "trend-fit.h"
+
+/*
+ * GPU sampling core, no GTK or GKrellM in here: devices are looked up,
+ * probed and sampled (on a worker pool, a slow sampler thread and an
+ * event listener) and every tick ends up in a snapshot on the sample bus.
+ * The plugin panel is one consumer, gknv-top another one.
+ */
+
+#define GK_MAX_TEXT 64
+
+#ifndef GK_MAX_GPUS
+ #define GK_MAX_GPUS 4
+#endif
+#define GK_MAX_GPU_FANS 1
+
+/* properties sampled by the slow sampler thread */
+#define GK_FIRST_SLOW_PROP GPU_PCIE_RX
+#define GK_LAST_SLOW_PROP GPU_NVLINK_TX
+#define GK_SLOW_PROPS (((1u << (GK_LAST_SLOW_PROP + 1)) - 1) & ~((1u << GK_FIRST_SLOW_PROP) - 1))
+
+/* lost GPUs probe period */
+#define GK_RECOVER_PERIOD_MS 5000
+
+/* clock event reasons tracked, bit r of the NVML mask */
+#define GK_CLOCK_REASONS 9
+
+/* ended reasons are still reported as recent for this long */
+#define GK_REASON_STICKY_MS 30000
+
+/* MIG instances on all GPUs, bitmasks indexed by instance are 64 bit */
+#ifndef GK_MAX_MIGS
+ #define GK_MAX_MIGS 64
+#endif
+
+#define INVALID_PROP -1u
+
+typedef enum _GPUProperty {
+	GPU_NAME,
+	GPU_USAGE,
+	GPU_CLOCK,
+	GPU_MEMCLOCK,
+	GPU_TEMP,
+	GPU_FAN,
+	GPU_FANUSAGE,
+	GPU_POWER,
+	GPU_MEMUSAGE,
+	GPU_USEDMEM,
+	GPU_RESERVEDMEM,
+	GPU_TOTALMEM,
+	GPU_PCIE_RX,
+	GPU_PCIE_TX,
+	GPU_NVLINK_RX,
+	GPU_NVLINK_TX,
+	GPU_SLOWDOWN,     /* seconds to thermal slowdown at the current trend */
+	GPU_CLOCK_REASONS,
+	GPU_MIG,          /* MIG instances in use */
+	GPU_PROPS_NUM
+} GPUProperty_t;
+
+/* unit of each property value, used to pick its format */
+extern const ValueUnit_t prop_unit[GPU_PROPS_NUM];
+
+/* short name of each property, as used in derived counter expressions */
+extern const char *const prop_key[GPU_PROPS_NUM];
+
+/* short name of each clock event reason */
+extern const char *const clock_reason_name[GK_CLOCK_REASONS];
+
+typedef struct _NVAdaptiveConfig {
+	boolean enable;
+	uint stable_secs;      /* stable readings needed before slowing down  */
+	uint idle_interval;    /* seconds between full samples while idle     */
+	uint usage_threshold;  /* GPU usage (%) forcing full rate             */
+	uint power_threshold;  /* power draw (W) forcing full rate, 0 = off   */
+	uint delta;            /* usage (%) or power (W) change forcing full rate */
+} NVAdaptiveConfig;
+
+typedef enum _GPUHealth {
+	GPU_OK,
+	GPU_DEGRADED,   /* some calls fail, the rest is still sampled */
+	GPU_LOST        /* quarantined until a new handle is found */
+} GPUHealth_t;
+
+/* values read from a device, what consumers see through the sample bus */
+typedef struct _NVGpuSample {
+	uint clock;
+	uint memclock;
+	uint temp;
+	uint fan;
+	uint fan_rpm;
+	uint pwr;
+	nvmlUsage_t usage;
+	nvmlMemory_t memory;
+	uint pcie_rx;
+	uint pcie_tx;
+	uint nvlink_rx;
+	uint nvlink_tx;
+	uint slowdown;
+	float temp_trend;  /* C per minute, 0 without enough samples */
+	float pwr_trend;   /* W per minute */
+	uint reasons;        /* clock event reasons active now */
+	uint recent_reasons; /* active within the last GK_REASON_STICKY_MS */
+	uint64 reason_ms[GK_CLOCK_REASONS];   /* total time active */
+	uint64 reason_seen[GK_CLOCK_REASONS]; /* last sample active, 0 = never */
+	uint mig_count;
+	uint mig_busy;
+} NVGpuSample;
+
+/* what is read from a MIG instance, the parent GPU has the rest */
+typedef struct _NVMigSample {
+	uint usage;
+	uint64 used;
+	uint64 total;
+} NVMigSample;
+
+typedef struct _NVMigInfo {
+	nvmlDevice_t h;
+	uint gpu;                 /* parent, index in gpu_info */
+	uint index;               /* slot on the parent */
+	char name[GK_MAX_TEXT];   /* profile, like 1g.10gb */
+	boolean busy;
+	boolean has_usage;
+	uint failures;            /* calls failed in a row, the parent isn't told */
+	uint64 last_active;
+	uint64 next_check;
+	nvmlMemory_t memory;
+	NVMigSample s;
+} NVMigInfo;
+
+typedef struct _NVGpuInfo {
+	boolean good;
+	boolean fresh;
+	boolean idle;
+	uint64 last_full;
+	uint64 stable_since;
+	uint ref_usage;
+	uint ref_pwr;
+	char name[GK_MAX_TEXT];
+	_Atomic(nvmlDevice_t) h;   /* also read by the event listener */
+	nvmlPciInfo_t pci;
+	uint caps;
+	NVGpuSample s;
+	uint fan_count;
+	nvmlFan_t fan_data[GK_MAX_GPU_FANS];
+	uint64 event_types;
+	atomic_uint dirty;
+	atomic_ullong pending;
+	atomic_ullong xid;
+	atomic_int health;
+	uint calls;
+	uint failures;
+	uint bad_ticks;
+	boolean gone;
+	uint64 next_probe;
+	_Atomic(nvmlDevice_t) recovered;
+	uint nvlink_links;
+	uint64 nvlink_rx_kib;
+	uint64 nvlink_tx_kib;
+	uint64 nvlink_time;
+	atomic_uint pcie_rx;
+	atomic_uint pcie_tx;
+	atomic_uint nvlink_rx;
+	atomic_uint nvlink_tx;
+	uint slowdown_temp;
+	uint64 trend_time;
+	TrendFit temp_fit;
+	TrendFit pwr_fit;
+	uint64 reason_time;
+	uint mig_slots;         /* instance slots on the device, 0 without MIG */
+	atomic_uint mig_used;   /* bitmask of slots holding an instance */
+	atomic_bool mig_rescan; /* instances to be enumerated again */
+	uint64 next_mig_scan;
+} NVGpuInfo;
+
+/* all GPUs at one instant, published once per sampling tick */
+typedef struct _NVSnapshot {
+	uint64 time;
+	uint64 good;   /* bitmasks indexed by GPU */
+	uint64 fresh;
+	uint64 idle;
+	uint64 degraded;
+	uint64 lost;
+	NVGpuSample gpu[GK_MAX_GPUS];
+	uint mig_count;
+	uint mig_gen;      /* mig_generation the instances belong to */
+	uint64 mig_busy;   /* bitmask indexed by instance */
+	NVMigSample mig[GK_MAX_MIGS];
+} NVSnapshot;
+
+#define GPU_BIT(i) (1ull << (i))
+
+extern GKNVMLLib nvml;
+extern NVGpuInfo gpu_info[GK_MAX_GPUS];
+extern NVAdaptiveConfig adaptive;
+
+/*
+ * instances of MIG enabled GPUs, found by update_gpu_info() and listed
+ * again by update_gpu_data() when they are created or destroyed, which
+ * bumps mig_generation
+ */
+extern NVMigInfo mig_info[GK_MAX_MIGS];
+extern uint mig_count;
+extern uint mig_generation;
+
+/* GPUs to monitor by PCI bus id or UUID, none means all of them */
+extern char gpu_selection[GK_MAX_GPUS][GK_MAX_TEXT];
+extern uint gpu_selection_count;
+
+/* once, before anything else */
+void init_gpu_sampler(void);
+
+/* bitmask of properties to sample (all by default), devices permitting */
+void set_sampled_props(uint props);
+
+/* where the capabilities cache lives, NULL or empty to probe every time */
+void set_caps_cache_dir(const char *dir);
+
+/* called from the event listener thread, after the event is recorded */
+void set_gpu_event_callback(void (*cb)(void));
+
+/* (re)discover selected GPUs, samplers must be stopped */
+void update_gpu_info(void);
+
+void start_samplers(void);
+void stop_samplers(void);
+
+/* sample every GPU and publish a snapshot if anything changed */
+void update_gpu_data(void);
+
+/* snapshots are read through a cursor, at the consumer pace */
+void attach_gpu_data(SampleCursor *cursor);
+boolean read_gpu_data(SampleCursor *cursor, NVSnapshot *snap);
+
+/* raw value of a property, FALSE when not available */
+boolean get_gpu_value(const NVGpuSample *s, int prop, uint64 *value);
+
+/* same, formatted in its unit */
+boolean format_gpu_value(const NVGpuSample *s,
+                         int prop,
+                         char *buf,
+                         int buf_size,
+                         uint precision);
+
+#endif /* GPU_SAMPLER_H */
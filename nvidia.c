@@ -19,20 +19,21 @@
  *                                                                           *
  *****************************************************************************/
 #include <gkrellm2/gkrellm.h>
-#include "nvml-lib.h"
+#include "gpu-sampler.h"
+#include "counter-expr.h"
+#include "ring-file.h"
 
 #define GK_PLUGIN_NAME "nvidia"
 #define GK_CONFIG_KEYWORD "nvidia"
-#define GK_MAX_TEXT 64
 #define GK_MAX_PATH CFG_BUFSIZE
 
-#ifndef GK_MAX_GPUS
- #define GK_MAX_GPUS 4
-#endif
-#define GK_MAX_GPU_FANS 1
+/* name row flashing duration on device events */
+#define GK_FLASH_TICKS 7
 
-static GKNVMLLib nvml;
 static gboolean reset_lib = FALSE;
+static gboolean panel_dirty = FALSE;
+static GtkWidget *rate_label = NULL;
+static GtkWidget *reasons_label = NULL;
 
 #ifndef GKFREQ_NVML_SONAME
  #define GKFREQ_NVML_SONAME "libnvidia-ml.so"
@@ -45,9 +46,6 @@ static gboolean reset_lib = FALSE;
 /* convert nvml return to boolean */
 #define NVFN(fn) (nvml.fn == NVML_SUCCESS)
 
-/* convert bytes to mbytes */
-#define B2MB(b) (b / 0x100000)
-
 /* mark unused variables to avoid compile warnings */
 #define UNUSED(x) (void)(x)
 
@@ -78,22 +76,6 @@ typedef enum _TextAlignment {
 	LEFT
 } TextAlignment_t;
 
-typedef enum _GPUProperty {
-	GPU_NAME,
-	GPU_USAGE,
-	GPU_CLOCK,
-	GPU_MEMCLOCK,
-	GPU_TEMP,
-	GPU_FAN,
-	GPU_FANUSAGE,
-	GPU_POWER,
-	GPU_MEMUSAGE,
-	GPU_USEDMEM,
-	GPU_RESERVEDMEM,
-	GPU_TOTALMEM,
-	GPU_PROPS_NUM
-} GPUProperty_t;
-
 typedef struct _GkrellmDecalRowInfo {
 	gboolean enable;
 	guint order;
@@ -114,38 +96,147 @@ static GkrellmDecalRowInfo_t decal_info[] = {
  { TRUE,  8, RIGHT,  _("Used Memory"),     _("GPU Used Memory (percentage)") },
  { TRUE,  9, RIGHT,  _("Used Memory"),     _("GPU Used Memory")              },
  { TRUE, 10, RIGHT,  _("Reserved Memory"), _("GPU Reserved Memory")          },
- { TRUE, 11, RIGHT,  _("Total Memory"),    _("GPU Total Memory")             } 
+ { TRUE, 11, RIGHT,  _("Total Memory"),    _("GPU Total Memory")             },
+ { FALSE,12, RIGHT,  _("PCIe RX"),         _("PCIe Receive Throughput")      },
+ { FALSE,13, RIGHT,  _("PCIe TX"),         _("PCIe Transmit Throughput")     },
+ { FALSE,14, RIGHT,  _("NVLink RX"),       _("NVLink Receive Throughput")    },
+ { FALSE,15, RIGHT,  _("NVLink TX"),       _("NVLink Transmit Throughput")   },
+ { TRUE, 16, RIGHT,  _("Slowdown"),        _("Time to Thermal Slowdown")     },
+ { TRUE, 17, RIGHT,  _("Clocks"),          _("Clock Event Reasons")          },
+ { TRUE, 18, RIGHT,  _("MIG"),             _("MIG Instances in Use")         }
 };
 
 /* make sure this stays consistent with gpu properties */
 ASSERT_SIZE(decal_info, GPU_PROPS_NUM);
 
+/* decimal digits for scaled values (GHz, W, GB) */
+static guint precision = 1;
+
+/* seconds to thermal slowdown highlighting the GPU name, 0 = off */
+static guint thermal_margin = 300;
+
+#define GK_MAX_DERIVED 4
+#define GK_MAX_EXPR_TEXT 128
+#define GK_MAX_UNIT_TEXT 16
+
+/* user defined rows, computed from the counters of the same GPU */
+typedef struct _NVDerivedRow {
+	gchar label[GK_MAX_TEXT];
+	gchar unit[GK_MAX_UNIT_TEXT];   /* appended to the value */
+	ValueUnit_t format;             /* raw unit scaled like counters, UNIT_NUM if not */
+	gchar source[GK_MAX_EXPR_TEXT];
+	gboolean valid;
+	CounterExpr expr;
+} NVDerivedRow;
+
+static NVDerivedRow derived_rows[GK_MAX_DERIVED];
+static guint derived_count = 0;
+
+/* what the Derived tab edits, copied to derived_rows on apply */
+static NVDerivedRow derived_edit[GK_MAX_DERIVED];
+static gboolean reset_derived = FALSE;
+
+/* rows of each GPU: one per property, then the derived ones */
+#define GK_MAX_ROWS (GPU_PROPS_NUM + GK_MAX_DERIVED)
+#define ROW(i, p) ((i) * GK_MAX_ROWS + (p))
+
+#define GK_SPARK_HEIGHT 8
+#define GK_MAX_SPARK_W 96
+
+/* sparkline settings, indexed by property */
+typedef struct _NVSparkConfig {
+	guint width;        /* pixels, 0 = no sparkline */
+	gboolean autoscale; /* otherwise fixed 0-100% where it makes sense */
+} NVSparkConfig;
+
+static NVSparkConfig spark_config[GPU_PROPS_NUM];
+
+/*
+ * last samples of a row drawn as a graph below it. The pixmap is filled
+ * with the text color once, only its mask is scrolled and drawn.
+ */
+typedef struct _NVSparkline {
+	GkrellmDecal *decal;
+	GdkPixmap *pixmap;
+	GdkBitmap *mask;
+	gint w;
+	guint head;
+	guint64 scale;
+	guint64 values[GK_MAX_SPARK_W];
+} NVSparkline;
+
+static GdkGC *spark_set_gc = NULL;
+static GdkGC *spark_clear_gc = NULL;
+
 typedef struct _GkrellmDecalRow {
 	GkrellmDecal *label;
 	GkrellmDecal *data;
+	char text[GK_MAX_TEXT];
+	gboolean hot;
+	guint64 reasons;    /* both reason masks the text was made from */
+	NVSparkline spark;
 } GkrellmDecalRow_t;
 
-static GkrellmDecalRow_t decal_text[GK_MAX_GPUS * GPU_PROPS_NUM];
+static GkrellmDecalRow_t decal_text[GK_MAX_GPUS * GK_MAX_ROWS];
 
-#define INVALID_PROP -1u
+/*
+ * MIG instances get a few rows below their GPU however many there are,
+ * see draw_mig_rows(). Instances going busy or idle only change what the
+ * rows show, the panel is rebuilt when they are created or destroyed (a
+ * new mig_generation).
+ */
+#define GK_MIG_ROWS 4
+#define MIG_ROW(i, j) ((i) * GK_MIG_ROWS + (j))
 
-typedef struct _NVGpuInfo {
-	gboolean good;
-	char name[GK_MAX_TEXT];
-	nvmlDevice_t h;
-	nvmlPciInfo_t pci;
-	guint clock;
-	guint memclock;
-	guint temp;
-	guint fan;
-	guint pwr;
-	nvmlUsage_t usage;
-	nvmlMemory_t memory;
-	guint fan_count;
-	nvmlFan_t fan_data[GK_MAX_GPU_FANS];
-} NVGpuInfo;
-
-static NVGpuInfo gpu_info[GK_MAX_GPUS];
+/* what a MIG row shows besides instances */
+#define GK_MIG_OTHERS GK_MAX_MIGS
+#define GK_MIG_BLANK (GK_MAX_MIGS + 1)
+
+static GkrellmDecalRow_t mig_rows[GK_MAX_GPUS * GK_MIG_ROWS];
+static guint mig_row_shown[GK_MAX_GPUS * GK_MIG_ROWS];
+static guint panel_mig_rows[GK_MAX_GPUS];
+static guint panel_mig_gen = 0;
+
+/* name row flashing on device events */
+typedef struct _NVGpuFlash {
+	guint ticks;
+	char text[GK_MAX_TEXT];
+} NVGpuFlash;
+
+static NVGpuFlash gpu_flash[GK_MAX_GPUS];
+
+/* the panel is just one of the bus consumers */
+static SampleCursor panel_cursor;
+static NVSnapshot panel_snapshot;
+
+/*
+ * last GK_MAX_SPARK_W samples of every counter, one file per GPU named
+ * after its bus id, so sparklines start full after a restart
+ */
+#define GK_HISTORY_FILE "nvidia-history"
+
+/* sample period assumed when the history has a single record, ms */
+#define GK_HISTORY_STEP_MS 1000
+
+static RingFile gpu_history[GK_MAX_GPUS];
+
+/* ~/.gkrellm2, for the capabilities cache and history files */
+static gchar user_dir[GK_MAX_PATH];
+
+static gboolean reset_gpus = FALSE;
+
+#define GK_MAX_GPU_CHOICES 16
+
+/* GPUs offered in the config tab */
+typedef struct _NVGpuChoice {
+	GtkWidget *button;
+	gboolean by_uuid;
+	gchar busid[GK_MAX_TEXT];
+	gchar uuid[GK_MAX_TEXT];
+} NVGpuChoice;
+
+static NVGpuChoice gpu_choices[GK_MAX_GPU_CHOICES];
+static guint gpu_choice_count = 0;
 
 static gboolean is_decal_enabled(GPUProperty_t prop)
 {
@@ -167,291 +258,833 @@ static void set_decal_enabled(GPUProperty_t prop, gboolean toggle)
 			decal_info[i].enable = toggle;
 }
 
-static void update_gpu_info(void)
+/* a raw unit (mW, bytes, ...) gets the counters format, W or GB */
+static void set_derived_unit(NVDerivedRow *r, const gchar *unit, int len)
 {
-	guint i, gpu_count, f;
-	NVGpuInfo *g;
+	snprintf(r->unit, sizeof(r->unit), "%.*s", len, unit);
+	r->format = value_unit_from_name(r->unit);
+}
 
-	memset(gpu_info, 0, sizeof(NVGpuInfo) * GK_MAX_GPUS);
+/* compiled once here, rows just run the program on every sample */
+static void set_derived_source(NVDerivedRow *r, const gchar *source)
+{
+	snprintf(r->source, sizeof(r->source), "%s", source);
 
-	if (NVFN(nvmlDeviceGetCount(&gpu_count)))
-		if (CLAMP(gpu_count, 0, GK_MAX_GPUS) > 0)
-			for (i = 0; i < gpu_count; ++i) {
-				g = &gpu_info[i];
-				g->good = NVFN(nvmlDeviceGetHandleByIndex(i, &(g->h)))        &&
-				          NVFN(nvmlDeviceGetName(g->h, g->name, GK_MAX_TEXT)) &&
-				          NVFN(nvmlDeviceGetPciInfo(g->h, &(g->pci)));
+	r->valid = counter_expr_compile(&r->expr, r->source, prop_key, GPU_PROPS_NUM) &&
+	           !(r->expr.vars & (1u << GPU_NAME));
+}
 
-				g->memory.version = nvmlMemory_ver;
+/* turn events collected by the listener into name row flashing */
+static gboolean process_gpu_events(int i)
+{
+	NVGpuFlash *f = &gpu_flash[i];
+	guint64 events = atomic_exchange(&gpu_info[i].pending, 0);
 
-				if (NVFN(nvmlDeviceGetNumFans(g->h, &(g->fan_count)))) 
-					g->fan_count = CLAMP(g->fan_count, 0, GK_MAX_GPU_FANS);
-				else
-					g->fan_count = 0;
+	if (!events)
+		return FALSE;
 
-				for (f = 0; f < g->fan_count; ++f) {
-					g->fan_data[f].version = nvmlFan_ver;
-					g->fan_data[f].fanidx = f;
-				}
-			}
+	if (events & nvmlEventTypeXidCriticalError)
+		snprintf(f->text, GK_MAX_TEXT, _("Xid %llu"), atomic_load(&gpu_info[i].xid));
+	else if (events & nvmlEventTypeClock)
+		strcpy(f->text, _("Clock change"));
+	else
+		strcpy(f->text, _("P-State change"));
+
+	f->ticks = GK_FLASH_TICKS;
+
+	return TRUE;
 }
 
-static void update_gpu_data(void)
+
+static gboolean get_gpu_data(int gpu_id, int info, char *buf, int buf_size)
 {
-	int i;
-	NVGpuInfo *g;
+	gboolean res = FALSE;
+	NVGpuInfo *g = &gpu_info[gpu_id];
+	NVGpuFlash *f = &gpu_flash[gpu_id];
+
+	if (g->good) {
+
+		if (info == GPU_NAME && (panel_snapshot.lost & GPU_BIT(gpu_id))) {
+			strcpy(buf, _("GPU lost"));
+			res = TRUE;
+		} else if (info == GPU_NAME) {
+			strcpy(buf, (f->ticks & 1)? f->text : g->name);
+			res = TRUE;
+		} else {
+			res = format_gpu_value(&panel_snapshot.gpu[gpu_id],
+			                       info,
+			                       buf,
+			                       buf_size,
+			                       precision);
+		}
+
+	}
+
+	if (!res)
+		strcpy(buf, "N/A");
+
+	return res;
+}
+
+static gboolean get_derived_data(int gpu_id, int k, char *buf, int buf_size)
+{
+	int p;
+	uint64 value;
+	double vars[GPU_PROPS_NUM], result;
+	gboolean negative;
+	const NVDerivedRow *r = &derived_rows[k];
+	const NVGpuSample *s = &panel_snapshot.gpu[gpu_id];
+
+	for (p = GPU_NAME + 1; p < GPU_PROPS_NUM; ++p)
+		if (r->expr.vars & (1u << p)) {
+
+			if (!get_gpu_value(s, p, &value))
+				goto not_available;
+
+			vars[p] = (double)value;
+		}
+
+	if (!gpu_info[gpu_id].good || !counter_expr_eval(&r->expr, vars, &result))
+		goto not_available;
+
+	/* a raw unit is formatted on the magnitude, the sign goes in front */
+	if (r->unit[0] != '\0' && r->format != UNIT_NUM) {
+		negative = (result < 0.0);
+		if (negative) {
+			buf[0] = '-';
+			result = -result;
+		}
+		format_value(buf + negative, buf_size - negative,
+		             (uint64)(result + 0.5), r->format, precision);
+	} else
+		snprintf(buf, buf_size, "%.*f%s", (int)precision, result, r->unit);
+
+	return TRUE;
+
+not_available:
+	strcpy(buf, "N/A");
+
+	return FALSE;
+}
+
+static gint panel_expose_event(GtkWidget *widget, GdkEventExpose *ev)
+{
+	gdk_draw_pixmap(widget->window,
+	                widget->style->fg_gc[GTK_WIDGET_STATE(widget)],
+	                plugin.panel->pixmap,
+	                ev->area.x,
+	                ev->area.y,
+	                ev->area.x,
+	                ev->area.y,
+	                ev->area.width,
+	                ev->area.height);
+
+	return 0;
+}
+
+static void panel_click_event(GtkWidget *w, GdkEventButton *event, gpointer p)
+{
+	UNUSED(w);
+	UNUSED(p);
+
+	if (event->button == GDK_BUTTON_SECONDARY)
+		gkrellm_open_config_window(plugin.monitor);
+}
+
+static void update_rate_label(void)
+{
+	int i, len = 0;
+	gchar text[GK_MAX_GPUS * GK_MAX_TEXT] = { '\0' };
+	static gchar shown[GK_MAX_GPUS * GK_MAX_TEXT] = { '\0' };
 
 	for (i = 0; i < GK_MAX_GPUS; ++i) {
-		
-		g = &gpu_info[i];
-		
-		if (!g->good)
+
+		if (!(panel_snapshot.good & GPU_BIT(i)))
+			continue;
+
+		if (panel_snapshot.lost & GPU_BIT(i))
+			len += snprintf(text + len, sizeof(text) - len,
+			                _("GPU %d: lost, retrying every %us\n"),
+			                i,
+			                GK_RECOVER_PERIOD_MS / 1000);
+		else if (panel_snapshot.degraded & GPU_BIT(i))
+			len += snprintf(text + len, sizeof(text) - len,
+			                _("GPU %d: degraded, some counters failing\n"),
+			                i);
+		else if (panel_snapshot.idle & GPU_BIT(i))
+			len += snprintf(text + len, sizeof(text) - len,
+			                _("GPU %d: idle, sampled every %us\n"),
+			                i,
+			                adaptive.idle_interval);
+		else
+			len += snprintf(text + len, sizeof(text) - len,
+			                _("GPU %d: full rate\n"),
+			                i);
+	}
+
+	if (strcmp(text, shown)) {
+		strcpy(shown, text);
+		gtk_label_set_text(GTK_LABEL(rate_label), shown);
+	}
+}
+
+/* total time and last occurrence of every reason seen, config tab only */
+static void update_reasons_label(void)
+{
+	int i, r, len = 0;
+	guint64 seen;
+	const NVGpuSample *s;
+	gchar total[GK_MAX_TEXT], ago[GK_MAX_TEXT];
+	gchar text[GK_MAX_GPUS * GK_CLOCK_REASONS * GK_MAX_TEXT] = { '\0' };
+	static gchar shown[GK_MAX_GPUS * GK_CLOCK_REASONS * GK_MAX_TEXT] = { '\0' };
+
+	for (i = 0; i < GK_MAX_GPUS; ++i) {
+
+		if (!(panel_snapshot.good & GPU_BIT(i)) ||
+		    !(gpu_info[i].caps & (1u << GPU_CLOCK_REASONS)))
 			continue;
 
-		if (!is_decal_enabled(GPU_CLOCK) ||
-		    !NVFN(nvmlDeviceGetClockInfo(g->h, NVML_CLOCK_GFX, &(g->clock))))
-			g->clock = INVALID_PROP;
+		s = &panel_snapshot.gpu[i];
+		len += snprintf(text + len, sizeof(text) - len, _("GPU %d:\n"), i);
 
-		if (!is_decal_enabled(GPU_MEMCLOCK) ||
-		    !NVFN(nvmlDeviceGetClockInfo(g->h, NVML_CLOCK_MEM, &(g->memclock))))
-			g->memclock = INVALID_PROP;
+		for (r = 0; r < GK_CLOCK_REASONS; ++r) {
 
-		if (!is_decal_enabled(GPU_TEMP) ||
-		    !NVFN(nvmlDeviceGetTemperature(g->h, NVML_TEMP_GPU, &(g->temp))))
-			g->temp = INVALID_PROP;
+			seen = s->reason_seen[r];
+			if (seen == 0)
+				continue;
 
-		if (!is_decal_enabled(GPU_FANUSAGE) ||
-		    !NVFN(nvmlDeviceGetFanSpeed_v2(g->h, 0, &(g->fan))))
-			g->fan = INVALID_PROP;
+			format_value(total, sizeof(total), s->reason_ms[r] / 1000, UNIT_SECONDS, precision);
 
-		if (!is_decal_enabled(GPU_FAN) ||
-		    !NVFN(nvmlDeviceGetFanSpeedRPM(g->h, &(g->fan_data[0]))))
-			g->fan_data[0].speed = INVALID_PROP;
+			if (s->reasons & (1u << r))
+				strcpy(ago, _("now"));
+			else
+				format_value(ago, sizeof(ago), (panel_snapshot.time - seen) / 1000,
+				             UNIT_SECONDS, precision);
 
-		if (!is_decal_enabled(GPU_POWER) ||
-		    !NVFN(nvmlDeviceGetPowerUsage(g->h, &(g->pwr))))
-			g->pwr = INVALID_PROP;
+			len += snprintf(text + len, sizeof(text) - len,
+			                _("    %-8s %s total, last %s\n"),
+			                clock_reason_name[r],
+			                total,
+			                ago);
+		}
+	}
 
-		if ((!is_decal_enabled(GPU_USAGE) && !is_decal_enabled(GPU_MEMUSAGE)) ||
-		    !NVFN(nvmlDeviceGetUtilizationRates(g->h, &(g->usage))))
-			g->usage.gpu = g->usage.memory = INVALID_PROP;
+	if (len == 0)
+		strcpy(text, _("No clock event reasons available"));
 
-		if ((!is_decal_enabled(GPU_USEDMEM) &&
-		     !is_decal_enabled(GPU_RESERVEDMEM) &&
-		     !is_decal_enabled(GPU_TOTALMEM)) ||
-		     !NVFN(nvmlDeviceGetMemoryInfo_v2(g->h, &(g->memory))))
-			g->memory.free =
-			g->memory.reserved =
-			g->memory.total =
-			g->memory.used = INVALID_PROP;
+	if (strcmp(text, shown)) {
+		strcpy(shown, text);
+		gtk_label_set_text(GTK_LABEL(reasons_label), shown);
 	}
 }
 
-static gboolean get_gpu_data(int gpu_id, int info, char *buf, int buf_size)
+/* name row in the alternate text style while slowdown is within the margin */
+static gboolean update_name_style(int i, GkrellmDecalRow_t *row)
 {
-	gboolean res = FALSE;
-	NVGpuInfo *g;
+	guint eta = panel_snapshot.gpu[i].slowdown;
+	gboolean hot = thermal_margin > 0 && eta != INVALID_PROP && eta < thermal_margin;
 
-	if (gpu_info[gpu_id].good) {
+	if (hot == row->hot)
+		return FALSE;
 
-		g = &gpu_info[gpu_id];
+	row->hot = hot;
+	row->data->text_style = hot? *gkrellm_meter_alt_textstyle(plugin.style_id)
+	                           : *gkrellm_meter_textstyle(plugin.style_id);
 
-		switch (info) {
-		case GPU_NAME:
-			strcpy(buf, g->name);
-			res = TRUE;
-			break;
+	/* same text, new colors: make gkrellm draw it again */
+	gkrellm_decal_text_clear(row->data);
 
-		case GPU_CLOCK:
-			snprintf(buf, buf_size, "%uMHz", g->clock);
-			res = g->clock != INVALID_PROP;
-			break;
+	return TRUE;
+}
+
+static gboolean draw_row_text(GkrellmDecalRow_t *row,
+                              gchar *label,
+                              TextAlignment_t alignment,
+                              const char *text,
+                              gboolean restyled)
+{
+	GkrellmStyle *style = gkrellm_panel_style(plugin.style_id);
+	GkrellmMargin *m = gkrellm_get_style_margins(style);
+	int w = gkrellm_chart_width();
+	int w_text;
+
+	/* unchanged rows cost nothing, not even measuring the text */
+	if (!panel_dirty && !restyled && !strcmp(text, row->text))
+		return FALSE;
+
+	strcpy(row->text, text);
+
+	if (panel_dirty)
+		gkrellm_draw_decal_text(plugin.panel, row->label, label, 0);
+
+	w_text = gkrellm_gdk_string_width(row->label->text_style.font, row->text);
+
+	switch (alignment) {
+	case LEFT:
+		row->data->x = m->left;
+		break;
+	case CENTER:
+		row->data->x = (w - w_text) / 2 - 1;
+		break;
+	case RIGHT:
+		row->data->x = w - m->left - m->right - w_text - 1;
+		break;
+	}
+
+	gkrellm_draw_decal_text(plugin.panel, row->data, row->text, 0);
+
+	return TRUE;
+}
+
+static gboolean draw_decal_row(int i, int p)
+{
+	gboolean restyled;
+	guint64 reasons;
+	char text[GK_MAX_TEXT];
+	GkrellmDecalRow_t *row = &decal_text[ROW(i, decal_info[p].order)];
+	const NVGpuSample *s = &panel_snapshot.gpu[i];
+
+	if (!decal_info[p].enable || row->label == NULL)
+		return FALSE;
+
+	/* reasons are put into words only when their bitmasks change */
+	if (decal_info[p].order == GPU_CLOCK_REASONS) {
+		reasons = ((guint64)s->recent_reasons << 32) | s->reasons;
+
+		if (!panel_dirty && row->text[0] && reasons == row->reasons)
+			return FALSE;
+
+		row->reasons = reasons;
+	}
+
+	get_gpu_data(i, decal_info[p].order, text, GK_MAX_TEXT);
+
+	restyled = (decal_info[p].order == GPU_NAME) && update_name_style(i, row);
+
+	return draw_row_text(row,
+	                     decal_info[p].label,
+	                     decal_info[p].alignment,
+	                     text,
+	                     restyled);
+}
+
+static gboolean draw_derived_row(int i, int k)
+{
+	char text[GK_MAX_TEXT];
+	GkrellmDecalRow_t *row = &decal_text[ROW(i, GPU_PROPS_NUM + k)];
+
+	if (row->label == NULL)
+		return FALSE;
+
+	get_derived_data(i, k, text, GK_MAX_TEXT);
+
+	return draw_row_text(row, derived_rows[k].label, RIGHT, text, FALSE);
+}
+
+/* rows show different instances over time, their labels follow */
+static gboolean draw_mig_slot(guint row, guint shown, gchar *label, const char *text)
+{
+	gboolean relabeled = (shown != mig_row_shown[row]);
+
+	if (relabeled) {
+		mig_row_shown[row] = shown;
+		gkrellm_draw_decal_text(plugin.panel, mig_rows[row].label, label, 0);
+	}
+
+	return draw_row_text(&mig_rows[row], label, RIGHT, text, relabeled) || relabeled;
+}
+
+/* load when the driver reports it, memory in use anyway */
+static gboolean draw_mig_row(guint row, guint m)
+{
+	char text[GK_MAX_TEXT];
+	int len = 0;
+	const NVMigSample *s = &panel_snapshot.mig[m];
+
+	if (!(panel_snapshot.mig_busy & (1ull << m)))
+		return draw_mig_slot(row, m, mig_info[m].name, _("idle"));
+
+	if (s->usage != INVALID_PROP) {
+		len = format_value(text, GK_MAX_TEXT, s->usage, UNIT_PERCENT, precision);
+		text[len++] = ' ';
+	}
+
+	if (s->used != INVALID_PROP)
+		format_value(text + len, GK_MAX_TEXT - len, s->used, UNIT_BYTES, precision);
+	else
+		snprintf(text + len, GK_MAX_TEXT - len, "N/A");
+
+	return draw_mig_slot(row, m, mig_info[m].name, text);
+}
+
+/*
+ * every instance of GPU i has a row while they fit. Past that, busy ones
+ * get the rows but one, which counts the others; rows left are blank.
+ */
+static gboolean draw_mig_rows(int i)
+{
+	guint m, j = 0, others = 0, rows = panel_mig_rows[i];
+	gboolean drawn = FALSE;
+	char text[GK_MAX_TEXT];
+
+	if (rows == 0)
+		return FALSE;
+
+	for (m = 0; m < panel_snapshot.mig_count; ++m) {
+
+		if (mig_info[m].gpu != (guint)i)
+			continue;
+
+		if (panel_snapshot.gpu[i].mig_count <= rows ||
+		    (j < rows - 1 && (panel_snapshot.mig_busy & (1ull << m))))
+			drawn |= draw_mig_row(MIG_ROW(i, j++), m);
+		else
+			++others;
+	}
+
+	if (others > 0) {
+		snprintf(text, sizeof(text), "+%u", others);
+		drawn |= draw_mig_slot(MIG_ROW(i, j++), GK_MIG_OTHERS, _("Others"), text);
+	}
+
+	while (j < rows)
+		drawn |= draw_mig_slot(MIG_ROW(i, j++), GK_MIG_BLANK, "", "");
+
+	return drawn;
+}
+
+/* round up to 1, 2 or 5 times a power of ten so the scale rarely changes */
+static guint64 nice_scale(guint64 v)
+{
+	guint64 p;
+
+	for (p = 1; ; p *= 10) {
+		if (v <= p)
+			return p;
+		if (v <= 2 * p)
+			return 2 * p;
+		if (v <= 5 * p)
+			return 5 * p;
+	}
+}
+
+/* full scale of fixed sparklines, 0 when the property has none */
+static guint64 spark_fixed_scale(int prop, const NVGpuSample *s)
+{
+	switch (prop_unit[prop]) {
+	case UNIT_PERCENT:
+	case UNIT_CELSIUS:
+		return 100;
+
+	case UNIT_BYTES:
+		return (s->memory.total != INVALID_PROP)? s->memory.total : 0;
+
+	default:
+		return 0;
+	}
+}
+
+static void draw_spark_column(NVSparkline *sp, gint x, guint64 value)
+{
+	gint h = (gint)MIN(value * GK_SPARK_HEIGHT / sp->scale, GK_SPARK_HEIGHT);
+
+	if (h == 0 && value > 0)
+		h = 1;
+
+	gdk_draw_line(sp->mask, spark_clear_gc, x, 0, x, GK_SPARK_HEIGHT - 1);
+
+	if (h > 0)
+		gdk_draw_line(sp->mask,
+		              spark_set_gc,
+		              x,
+		              GK_SPARK_HEIGHT - h,
+		              x,
+		              GK_SPARK_HEIGHT - 1);
+}
+
+static guint64 spark_scale(const NVSparkline *sp, guint64 fixed)
+{
+	gint x;
+	guint64 scale = 0;
+
+	if (fixed > 0)
+		return fixed;
+
+	for (x = 0; x < sp->w; ++x)
+		scale = MAX(scale, sp->values[x]);
 
-		case GPU_MEMCLOCK:
-			snprintf(buf, buf_size, "%uMHz", g->memclock);
-			res = g->memclock != INVALID_PROP;
+	return nice_scale(scale);
+}
+
+static void redraw_sparkline(NVSparkline *sp)
+{
+	gint x;
+
+	for (x = 0; x < sp->w; ++x)
+		draw_spark_column(sp, x, sp->values[(sp->head + x) % sp->w]);
+}
+
+static void push_sparkline(NVSparkline *sp, guint64 value, guint64 fixed)
+{
+	guint64 scale;
+
+	sp->values[sp->head] = value;
+	sp->head = (sp->head + 1) % sp->w;
+
+	scale = spark_scale(sp, fixed);
+
+	if (scale != sp->scale) {
+		/* the whole graph moves with the scale */
+		sp->scale = scale;
+		redraw_sparkline(sp);
+	} else {
+		gdk_draw_pixmap(sp->mask,
+		                spark_set_gc,
+		                sp->mask,
+		                1, 0,
+		                0, 0,
+		                sp->w - 1, GK_SPARK_HEIGHT);
+
+		draw_spark_column(sp, sp->w - 1, value);
+	}
+
+	sp->decal->modified = TRUE;
+}
+
+static gboolean push_gpu_sparklines(int i)
+{
+	int p;
+	uint64 value;
+	gboolean drawn = FALSE;
+	NVSparkline *sp;
+	const NVGpuSample *s = &panel_snapshot.gpu[i];
+
+	for (p = GPU_NAME + 1; p < GPU_PROPS_NUM; ++p) {
+
+		sp = &decal_text[ROW(i, p)].spark;
+
+		if (!sp->decal)
+			continue;
+
+		if (!get_gpu_value(s, p, &value))
+			value = 0;
+
+		push_sparkline(sp,
+		               value,
+		               spark_config[p].autoscale? 0 : spark_fixed_scale(p, s));
+		drawn = TRUE;
+	}
+
+	return drawn;
+}
+
+/* every counter is kept, sparklines enabled later have a past too */
+static void record_gpu_history(int i)
+{
+	int p;
+	uint64 *record;
+	RingFile *r = &gpu_history[i];
+
+	if (!r->map)
+		return;
+
+	record = ring_file_begin(r);
+
+	for (p = 0; p < GPU_PROPS_NUM; ++p)
+		if (!get_gpu_value(&panel_snapshot.gpu[i], p, &record[p]))
+			record[p] = 0;
+
+	/* wall clock, it has to mean something after a reboot too */
+	ring_file_commit(r, g_get_real_time() / 1000);
+}
+
+/*
+ * a new sparkline starts from the newest recorded values, placed where
+ * they would be had the plugin kept running: the time since a record
+ * was written, in sample periods, is its distance from the right edge.
+ * Records older than the sparkline are dropped.
+ */
+static void seed_sparkline(int i, GPUProperty_t prop, NVSparkline *sp)
+{
+	guint x, n, col;
+	guint64 now = g_get_real_time() / 1000, t, newer, gap, step = GK_HISTORY_STEP_MS;
+	const uint64 *record;
+	RingFile *r = &gpu_history[i];
+
+	if (!r->map || (n = ring_file_count(r)) == 0)
+		return;
+
+	if (n > 1) {
+		ring_file_get(r, 0, &newer);
+		ring_file_get(r, 1, &t);
+		if (newer > t)
+			step = newer - t;
+	}
+
+	for (col = 0, newer = now, x = 0; x < n; ++x) {
+
+		record = ring_file_get(r, x, &t);
+
+		/* written in the future, the clock was moved back */
+		if (t > newer)
 			break;
 
-		case GPU_TEMP:
-			snprintf(buf, buf_size, "%.01fC", (float)(g->temp));
-			res = g->temp != INVALID_PROP;
+		/* one record per column, at least */
+		gap = (newer - t + step / 2) / step;
+		if (x > 0 && gap == 0)
+			gap = 1;
+
+		col += (guint)MIN(gap, (guint64)sp->w);
+
+		if (col >= (guint)sp->w)
 			break;
 
-		case GPU_FANUSAGE:
-			snprintf(buf, buf_size, "%u%%", CLAMP(g->fan, 0u, 100u));
-			res = g->fan != INVALID_PROP;
-			break;
+		sp->values[sp->w - 1 - col] = record[prop];
+		newer = t;
+	}
+
+	sp->head = 0;
+	sp->scale = spark_scale(sp,
+	                        spark_config[prop].autoscale? 0 :
+	                        spark_fixed_scale(prop, &panel_snapshot.gpu[i]));
+	redraw_sparkline(sp);
+
+	sp->decal->modified = TRUE;
+}
+
+static void open_gpu_history(void)
+{
+	int i;
+	gchar path[GK_MAX_PATH];
+
+	for (i = 0; i < GK_MAX_GPUS; ++i) {
+		ring_file_close(&gpu_history[i]);
+
+		if (gpu_info[i].good && user_dir[0] != '\0' &&
+		    snprintf(path, sizeof(path), "%s/%s-%s",
+		             user_dir, GK_HISTORY_FILE, gpu_info[i].pci.busId) < (int)sizeof(path))
+			ring_file_open(&gpu_history[i],
+			               path,
+			               gpu_info[i].pci.busId,
+			               GPU_PROPS_NUM,
+			               GK_MAX_SPARK_W);
+	}
+}
+
+/* called from main loop on listener request, shows events without delay */
+static gboolean cb_gpu_event(gpointer data)
+{
+	int i;
+	gboolean drawn = FALSE;
+
+	UNUSED(data);
+
+	for (i = 0; i < GK_MAX_GPUS; ++i)
+		if (gpu_info[i].good && process_gpu_events(i) && plugin.panel)
+			drawn |= draw_decal_row(i, GPU_NAME);
+
+	if (drawn && plugin.panel)
+		gkrellm_draw_panel_layers(plugin.panel);
+
+	return FALSE;
+}
+
+/* event listener thread, GTK calls belong to the main loop */
+static void notify_gpu_event(void)
+{
+	g_idle_add(cb_gpu_event, NULL);
+}
+
+/* the panel is rebuilt when MIG instance rows come and go */
+static void rebuild_nv_panel(void);
+
+static void update_plugin(void)
+{
+	int i, p, k;
+	gboolean drawn = FALSE, flashing;
+	guint64 fresh = 0;
+	NVGpuInfo *g;
+
+	update_gpu_data();
 
-		case GPU_FAN:
-			snprintf(buf, buf_size, "%uRPM", g->fan_data[0].speed);
-			res = g->fan_count > 0 && g->fan_data[0].speed != INVALID_PROP;
-			break;
+	/* catch up with everything published since the last tick */
+	while (read_gpu_data(&panel_cursor, &panel_snapshot))
+		fresh |= panel_snapshot.fresh;
 
-		case GPU_POWER:
-			snprintf(buf, buf_size, "%uW", g->pwr / 1000);
-			res = g->pwr != INVALID_PROP;
-			break;
+	if (rate_label)
+		update_rate_label();
 
-		case GPU_USAGE:
-			snprintf(buf, buf_size, "%u%%", g->usage.gpu);
-			res = g->usage.gpu != INVALID_PROP;
-			break;
+	if (reasons_label)
+		update_reasons_label();
 
-		case GPU_MEMUSAGE:
-			snprintf(buf, buf_size, "%u%%", g->usage.memory);
-			res = g->usage.memory != INVALID_PROP;
-			break;
+	/* instances were created or destroyed since the rows were made */
+	if (fresh && panel_snapshot.mig_gen != panel_mig_gen)
+		rebuild_nv_panel();
 
-		case GPU_USEDMEM:
-			snprintf(buf, buf_size, "%lluMB", B2MB(g->memory.used));
-			res = g->memory.used != INVALID_PROP;
-			break;
+	for (i = 0; i < GK_MAX_GPUS; ++i) {
 
-		case GPU_RESERVEDMEM:
-			snprintf(buf, buf_size, "%lluMB", B2MB(g->memory.reserved));
-			res = g->memory.reserved != INVALID_PROP;
-			break;
+		g = &gpu_info[i];
 
-		case GPU_TOTALMEM:
-			snprintf(buf, buf_size, "%lluMB", B2MB(g->memory.total));
-			res = g->memory.total != INVALID_PROP;
-			break;
+		if (!g->good)
+			continue;
 
-		default:
-			res = FALSE;
-			break;
+		flashing = (gpu_flash[i].ticks > 0);
+		if (flashing)
+			--gpu_flash[i].ticks;
+
+		flashing |= process_gpu_events(i);
+
+		if ((fresh & GPU_BIT(i)) || panel_dirty) {
+			for (p = 0; p < GPU_PROPS_NUM; ++p)
+				drawn |= draw_decal_row(i, p);
+			for (k = 0; k < GK_MAX_DERIVED; ++k)
+				drawn |= draw_derived_row(i, k);
+			if (panel_snapshot.mig_gen == panel_mig_gen)
+				drawn |= draw_mig_rows(i);
+		} else if (flashing) {
+			drawn |= draw_decal_row(i, GPU_NAME);
 		}
 
+		if (fresh & GPU_BIT(i)) {
+			drawn |= push_gpu_sparklines(i);
+			record_gpu_history(i);
+		}
 	}
 
-	if (!res)
-		strcpy(buf, "N/A");
+	if (drawn)
+		gkrellm_draw_panel_layers(plugin.panel);
 
-	return res;
+	panel_dirty = FALSE;
 }
 
-static gint panel_expose_event(GtkWidget *widget, GdkEventExpose *ev)
+static int create_row(GkrellmDecalRow_t *row,
+                      gchar *label,
+                      gchar *text,
+                      int y)
 {
-	gdk_draw_pixmap(widget->window,
-	                widget->style->fg_gc[GTK_WIDGET_STATE(widget)],
-	                plugin.panel->pixmap,
-	                ev->area.x,
-	                ev->area.y,
-	                ev->area.x,
-	                ev->area.y,
-	                ev->area.width,
-	                ev->area.height);
+	GkrellmStyle *style = gkrellm_meter_style(plugin.style_id);
+	GkrellmTextstyle *ts = gkrellm_meter_textstyle(plugin.style_id);
 
-	return 0;
+	row->label = gkrellm_create_decal_text(plugin.panel,
+	                                       label,
+	                                       ts,
+	                                       style,
+	                                       -1,
+	                                       y,
+	                                       -1);
+	
+	row->data = gkrellm_create_decal_text(plugin.panel,
+	                                      text,
+	                                      ts,
+	                                      style,
+	                                      -1,
+	                                      y,
+	                                      -1);
+
+	return MAX(row->label->y, row->data->y) +
+	       MAX(row->label->h, row->data->h);
 }
 
-static void panel_click_event(GtkWidget *w, GdkEventButton *event, gpointer p)
+static int create_decal_row(int i,
+                            int offset,
+                            gchar *label,
+                            gchar *text,
+                            int y)
 {
-	UNUSED(w);
-	UNUSED(p);
-
-	if (event->button == GDK_BUTTON_SECONDARY)
-		gkrellm_open_config_window(plugin.monitor);
+	return create_row(&decal_text[ROW(i, offset)], label, text, y);
 }
 
-static void update_plugin(void)
+/*
+ * in a strip below its row: label and value leave no room in the row
+ * itself, and the value width changes with every sample
+ */
+static int create_sparkline(int i, GPUProperty_t prop, int y)
 {
-	GkrellmStyle *style = gkrellm_panel_style(plugin.style_id);
+	GkrellmStyle *style = gkrellm_meter_style(plugin.style_id);
+	GkrellmTextstyle *ts = gkrellm_meter_textstyle(plugin.style_id);
 	GkrellmMargin *m = gkrellm_get_style_margins(style);
-	GkrellmDecal *d;
+	GdkWindow *window = gkrellm_get_top_window()->window;
+	NVSparkline *sp = &decal_text[ROW(i, prop)].spark;
+	GdkColor bit = { 0 };
+	GdkGC *gc;
 	int w = gkrellm_chart_width();
-	int w_text, i, p, idx, p_idx;
-	static char prop[GK_MAX_TEXT] = "N/A";
 
-	update_gpu_data();
+	sp->w = MIN((int)spark_config[prop].width, w - m->left - m->right);
+	if (sp->w <= 1)
+		return y;
 
-	for (i = 0; i < GK_MAX_GPUS; ++i) {
+	sp->pixmap = gdk_pixmap_new(window, sp->w, GK_SPARK_HEIGHT, -1);
+	sp->mask = gdk_pixmap_new(window, sp->w, GK_SPARK_HEIGHT, 1);
 
-		if (!gpu_info[i].good)
-			continue;
+	if (!spark_set_gc) {
+		spark_set_gc = gdk_gc_new(sp->mask);
+		spark_clear_gc = gdk_gc_new(sp->mask);
+		bit.pixel = 1;
+		gdk_gc_set_foreground(spark_set_gc, &bit);
+		bit.pixel = 0;
+		gdk_gc_set_foreground(spark_clear_gc, &bit);
+	}
 
-		idx = i * GPU_PROPS_NUM;
-
-		for (p = 0; p < GPU_PROPS_NUM; ++p) {
-
-			p_idx = decal_info[p].order;
-
-			d = decal_text[idx + p_idx].label;
-
-			if (decal_info[p].enable && d != NULL) {
-
-				gkrellm_draw_decal_text(plugin.panel,
-				                        d,
-				                        decal_info[p].label,
-				                        0);
-
-				get_gpu_data(i, p_idx, prop, GK_MAX_TEXT);
-				
-				w_text = gkrellm_gdk_string_width(d->text_style.font, prop);
-
-				switch (decal_info[p].alignment) {
-				case LEFT:
-					decal_text[idx + p_idx].data->x = m->left;
-					break;
-				case CENTER:
-					decal_text[idx + p_idx].data->x = (w - w_text) / 2 - 1;
-					break;
-				case RIGHT:
-					decal_text[idx + p_idx].data->x = w -
-					                                  m->left -
-					                                  m->right -
-					                                  w_text -
-					                                  1;
-					break;
-				}
-
-				gkrellm_draw_decal_text(plugin.panel,
-				                        decal_text[idx + p_idx].data,
-				                        prop,
-				                        0);
-			}
+	gc = gdk_gc_new(sp->pixmap);
+	gdk_gc_set_foreground(gc, &ts->color);
+	gdk_draw_rectangle(sp->pixmap, gc, TRUE, 0, 0, sp->w, GK_SPARK_HEIGHT);
+	g_object_unref(gc);
 
-		}
-	}
+	gdk_draw_rectangle(sp->mask, spark_clear_gc, TRUE, 0, 0, sp->w, GK_SPARK_HEIGHT);
+
+	sp->decal = gkrellm_create_decal_pixmap(plugin.panel,
+	                                        sp->pixmap,
+	                                        sp->mask,
+	                                        1,
+	                                        style,
+	                                        w - m->right - sp->w,
+	                                        y);
+
+	seed_sparkline(i, prop, sp);
 
-	gkrellm_draw_panel_layers(plugin.panel);
+	return sp->decal->y + sp->decal->h;
 }
 
-static int create_decal_row(int i,
-                            GPUProperty_t offset,
-                            gchar *label,
-                            gchar *text,
-                            int y)
+/* decals go away with the panel, pixmaps are ours */
+static void destroy_sparklines(void)
 {
-	GkrellmStyle *style = gkrellm_meter_style(plugin.style_id);
-	GkrellmTextstyle *ts = gkrellm_meter_textstyle(plugin.style_id);
-	int idx = i * GPU_PROPS_NUM + offset;
-
-	decal_text[idx].label = gkrellm_create_decal_text(plugin.panel,
-	                                                  label,
-	                                                  ts,
-	                                                  style,
-	                                                  -1,
-	                                                  y,
-	                                                  -1);
-	
-	decal_text[idx].data = gkrellm_create_decal_text(plugin.panel,
-	                                                 text,
-	                                                 ts,
-	                                                 style,
-	                                                 -1,
-	                                                 y,
-	                                                 -1);
+	guint i;
 
-	return MAX(decal_text[idx].label->y, decal_text[idx].data->y) +
-	       MAX(decal_text[idx].label->h, decal_text[idx].data->h);
+	for (i = 0; i < ARRAY_SIZE(decal_text); ++i)
+		if (decal_text[i].spark.pixmap) {
+			g_object_unref(decal_text[i].spark.pixmap);
+			g_object_unref(decal_text[i].spark.mask);
+		}
 }
 
 static void populate_panel(void)
 {
-	int i, j, y, p;
+	int i, j, k, y, p;
 	char* l;
+	guint props = 0;
+	NVDerivedRow *r;
 	static char SIZE_STRING[] = "WWWWWWWW";
+
+	panel_dirty = TRUE;
+
+	/* decals of a destroyed panel are gone, unused rows must stay NULL */
+	destroy_sparklines();
+	memset(decal_text, 0, sizeof(decal_text));
+	memset(mig_rows, 0, sizeof(mig_rows));
+	memset(panel_mig_rows, 0, sizeof(panel_mig_rows));
+
+	panel_mig_gen = mig_generation;
+
+	/* don't sample what isn't shown */
+	for (j = GPU_NAME; j < GPU_PROPS_NUM; ++j)
+		if (is_decal_enabled(j))
+			props |= 1u << j;
+
+	for (k = 0; k < GK_MAX_DERIVED; ++k)
+		if (derived_rows[k].valid)
+			props |= derived_rows[k].expr.vars;
+
+	set_sampled_props(props);
 	
 	for (y = -1, i = 0; i < GK_MAX_GPUS; ++i) {
 
@@ -460,14 +1093,39 @@ static void populate_panel(void)
 
 		for (j = GPU_NAME; j < GPU_PROPS_NUM; ++j) {
 
-			if (decal_info[j].enable) {
-				p = decal_info[j].order;
+			p = decal_info[j].order;
+
+			/* hide what the device can't provide */
+			if (decal_info[j].enable && (gpu_info[i].caps & (1u << p))) {
 				l = decal_info[j].label;
 				y = create_decal_row(i, p, l, SIZE_STRING, y);
+
+				if (spark_config[p].width > 0 && p != GPU_NAME &&
+				    p != GPU_CLOCK_REASONS)
+					y = create_sparkline(i, p, y + 1);
+
 				y += ((j == GPU_NAME)? 5 : 1);
 			}
 
 		}
+
+		/* derived rows need every counter they read */
+		for (k = 0; k < GK_MAX_DERIVED; ++k) {
+			r = &derived_rows[k];
+
+			if (r->valid && (gpu_info[i].caps & r->expr.vars) == r->expr.vars)
+				y = create_decal_row(i, GPU_PROPS_NUM + k, r->label, SIZE_STRING, y) + 1;
+		}
+
+		if (!is_decal_enabled(GPU_MIG) || !(gpu_info[i].caps & (1u << GPU_MIG)))
+			continue;
+
+		/* labels change with the instances shown, make room for any */
+		panel_mig_rows[i] = MIN(gpu_info[i].s.mig_count, GK_MIG_ROWS);
+		for (k = 0; k < (int)panel_mig_rows[i]; ++k) {
+			mig_row_shown[MIG_ROW(i, k)] = GK_MIG_BLANK;
+			y = create_row(&mig_rows[MIG_ROW(i, k)], SIZE_STRING, SIZE_STRING, y) + 1;
+		}
 	}
 }
 
@@ -513,10 +1171,16 @@ static void shutdown_plugin(void)
 {
 	int i;
 
+	/* sampler threads read good, they must be gone first */
+	stop_samplers();
+
 	for (i = 0; i < GK_MAX_GPUS; ++i)
 		gpu_info[i].good = FALSE;
 
 	shutdown_gpulib(&nvml);
+
+	for (i = 0; i < GK_MAX_GPUS; ++i)
+		ring_file_close(&gpu_history[i]);
 }
 
 static void create_plugin(GtkWidget* vbox, gint first_create)
@@ -527,8 +1191,14 @@ static void create_plugin(GtkWidget* vbox, gint first_create)
 		gtk_widget_show(plugin.main_vbox);
 	}
 
-	if (initialize_gpulib(&nvml))
-			update_gpu_info();
+	stop_samplers();
+
+	if (initialize_gpulib(&nvml)) {
+		update_gpu_info();
+		start_samplers();
+	}
+
+	open_gpu_history();
 
 	gkrellm_disable_plugin_connect(plugin.monitor, shutdown_plugin);
 
@@ -537,9 +1207,14 @@ static void create_plugin(GtkWidget* vbox, gint first_create)
 
 static void cb_toggle(GtkWidget *button, gpointer data)
 {
+	int i;
 	gboolean active = gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(button));
 	set_decal_enabled(GPOINTER_TO_INT(data), active);
 
+	/* event-driven counters need a fresh read once enabled */
+	for (i = 0; i < GK_MAX_GPUS; ++i)
+		atomic_fetch_or(&gpu_info[i].dirty, 1u << GPOINTER_TO_INT(data));
+
 	rebuild_nv_panel();
 }
 
@@ -670,6 +1345,384 @@ static void cb_drag_data_received(GtkWidget        *widget,
 	}
 }
 
+static void cb_adaptive_toggle(GtkWidget *button, gpointer data)
+{
+	UNUSED(data);
+
+	adaptive.enable = gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(button));
+}
+
+static void cb_spin_uint(GtkWidget *spin, gpointer data)
+{
+	*(guint*)data = gtk_spin_button_get_value_as_int(GTK_SPIN_BUTTON(spin));
+}
+
+static void cb_precision(GtkWidget *spin, gpointer data)
+{
+	UNUSED(data);
+
+	precision = gtk_spin_button_get_value_as_int(GTK_SPIN_BUTTON(spin));
+	panel_dirty = TRUE;
+}
+
+static void create_sampling_tab(GtkWidget *tabs)
+{
+	GtkWidget *vbox, *advbox, *thermvbox, *ratevbox;
+
+	vbox = gkrellm_gtk_framed_notebook_page(tabs, _(" Sampling "));
+
+	advbox = gkrellm_gtk_framed_vbox(vbox,
+	                                 _(" Adaptive Sampling "),
+	                                 2,
+	                                 FALSE,
+	                                 4,
+	                                 4);
+
+	gkrellm_gtk_check_button_connected(advbox,
+	                                   NULL,
+	                                   adaptive.enable,
+	                                   FALSE,
+	                                   FALSE,
+	                                   0,
+	                                   cb_adaptive_toggle,
+	                                   NULL,
+	                                   _("Lower sampling rate on idle GPUs"));
+
+	gkrellm_gtk_spin_button(advbox, NULL,
+	                        adaptive.stable_secs, 1, 600, 1, 10, 0, 60,
+	                        cb_spin_uint, &adaptive.stable_secs, FALSE,
+	                        _("Seconds of stable readings before slowing down"));
+
+	gkrellm_gtk_spin_button(advbox, NULL,
+	                        adaptive.idle_interval, 2, 60, 1, 5, 0, 60,
+	                        cb_spin_uint, &adaptive.idle_interval, FALSE,
+	                        _("Seconds between samples while idle"));
+
+	gkrellm_gtk_spin_button(advbox, NULL,
+	                        adaptive.usage_threshold, 1, 100, 1, 5, 0, 60,
+	                        cb_spin_uint, &adaptive.usage_threshold, FALSE,
+	                        _("GPU load (%) restoring full rate"));
+
+	gkrellm_gtk_spin_button(advbox, NULL,
+	                        adaptive.power_threshold, 0, 1000, 1, 10, 0, 60,
+	                        cb_spin_uint, &adaptive.power_threshold, FALSE,
+	                        _("Power draw (W) restoring full rate (0 = off)"));
+
+	gkrellm_gtk_spin_button(advbox, NULL,
+	                        adaptive.delta, 1, 100, 1, 5, 0, 60,
+	                        cb_spin_uint, &adaptive.delta, FALSE,
+	                        _("Load (%) or power (W) change restoring full rate"));
+
+	thermvbox = gkrellm_gtk_framed_vbox(vbox,
+	                                    _(" Thermal Trend "),
+	                                    2,
+	                                    FALSE,
+	                                    4,
+	                                    4);
+
+	gkrellm_gtk_spin_button(thermvbox, NULL,
+	                        thermal_margin, 0, 3600, 10, 60, 0, 60,
+	                        cb_spin_uint, &thermal_margin, FALSE,
+	                        _("Highlight GPU name when slowdown is closer than (s, 0 = off)"));
+
+	ratevbox = gkrellm_gtk_framed_vbox(vbox,
+	                                   _(" Effective Rate "),
+	                                   2,
+	                                   TRUE,
+	                                   4,
+	                                   4);
+
+	rate_label = gtk_label_new("");
+	gtk_box_pack_start(GTK_BOX(ratevbox), rate_label, FALSE, FALSE, 0);
+	g_signal_connect(G_OBJECT(rate_label),
+	                 "destroy",
+	                 G_CALLBACK(gtk_widget_destroyed),
+	                 &rate_label);
+
+	update_rate_label();
+}
+
+static void create_reasons_tab(GtkWidget *tabs)
+{
+	GtkWidget *vbox, *reasonvbox;
+
+	vbox = gkrellm_gtk_framed_notebook_page(tabs, _(" Clock Events "));
+	reasonvbox = gkrellm_gtk_framed_vbox(vbox,
+	                                     _(" Clocks Below Maximum Since Start "),
+	                                     2,
+	                                     TRUE,
+	                                     4,
+	                                     4);
+
+	reasons_label = gtk_label_new("");
+	gtk_box_pack_start(GTK_BOX(reasonvbox), reasons_label, FALSE, FALSE, 0);
+	g_signal_connect(G_OBJECT(reasons_label),
+	                 "destroy",
+	                 G_CALLBACK(gtk_widget_destroyed),
+	                 &reasons_label);
+
+	update_reasons_label();
+}
+
+static void cb_spark_width(GtkWidget *spin, gpointer data)
+{
+	int prop = GPOINTER_TO_INT(data);
+
+	spark_config[prop].width = gtk_spin_button_get_value_as_int(GTK_SPIN_BUTTON(spin));
+
+	rebuild_nv_panel();
+}
+
+static void cb_spark_autoscale(GtkWidget *button, gpointer data)
+{
+	int i, prop = GPOINTER_TO_INT(data);
+
+	spark_config[prop].autoscale = gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(button));
+
+	/* redraw with the new scale on next sample */
+	for (i = 0; i < GK_MAX_GPUS; ++i)
+		decal_text[ROW(i, prop)].spark.scale = 0;
+}
+
+static void create_sparklines_tab(GtkWidget *tabs)
+{
+	int i, prop;
+	GtkWidget *vbox, *sparkvbox, *hbox;
+
+	vbox = gkrellm_gtk_framed_notebook_page(tabs, _(" Sparklines "));
+	sparkvbox = gkrellm_gtk_framed_vbox(vbox,
+	                                    _(" Width in pixels (0 = off) "),
+	                                    2,
+	                                    TRUE,
+	                                    4,
+	                                    4);
+
+	/* same order as the Counters list */
+	for (i = GPU_NAME + 1; i < GPU_PROPS_NUM; ++i) {
+
+		prop = decal_info[i].order;
+
+		/* a bitmask, nothing to plot */
+		if (prop == GPU_CLOCK_REASONS)
+			continue;
+
+		hbox = gtk_hbox_new(FALSE, 0);
+		gtk_box_pack_start(GTK_BOX(sparkvbox), hbox, FALSE, FALSE, 0);
+
+		gkrellm_gtk_spin_button(hbox, NULL,
+		                        spark_config[prop].width, 0, GK_MAX_SPARK_W, 1, 10, 0, 50,
+		                        cb_spark_width, GINT_TO_POINTER(prop), FALSE,
+		                        decal_info[i].optionlabel);
+
+		gkrellm_gtk_check_button_connected(hbox,
+		                                   NULL,
+		                                   spark_config[prop].autoscale,
+		                                   FALSE,
+		                                   FALSE,
+		                                   -1,
+		                                   cb_spark_autoscale,
+		                                   GINT_TO_POINTER(prop),
+		                                   _("Autoscale"));
+	}
+}
+
+static void cb_derived_label(GtkWidget *widget, gpointer data)
+{
+	NVDerivedRow *r = &derived_edit[GPOINTER_TO_INT(data)];
+	gchar *text = gkrellm_gtk_entry_get_text(&widget);
+
+	/* '=' ends the label in the config line */
+	snprintf(r->label, sizeof(r->label), "%.*s", (int)strcspn(text, "="), text);
+	reset_derived = TRUE;
+}
+
+static void cb_derived_unit(GtkWidget *widget, gpointer data)
+{
+	NVDerivedRow *r = &derived_edit[GPOINTER_TO_INT(data)];
+	gchar *text = gkrellm_gtk_entry_get_text(&widget);
+
+	/* a single word in the config line */
+	set_derived_unit(r, text, (int)strcspn(text, " \t"));
+	reset_derived = TRUE;
+}
+
+static void cb_derived_source(GtkWidget *widget, gpointer data)
+{
+	NVDerivedRow *r = &derived_edit[GPOINTER_TO_INT(data)];
+
+	set_derived_source(r, gkrellm_gtk_entry_get_text(&widget));
+	gkrellm_gtk_entry_set_icon(widget, r->valid || r->source[0] == '\0');
+	reset_derived = TRUE;
+}
+
+static void create_derived_tab(GtkWidget *tabs)
+{
+	int k, p, len;
+	GtkWidget *vbox, *rowvbox, *entry;
+	gchar title[GK_MAX_TEXT], names[GPU_PROPS_NUM * 16];
+
+	vbox = gkrellm_gtk_framed_notebook_page(tabs, _(" Derived "));
+
+	/* rows on the panel don't change until applied */
+	memcpy(derived_edit, derived_rows, sizeof(derived_rows));
+
+	for (k = 0; k < GK_MAX_DERIVED; ++k) {
+
+		snprintf(title, sizeof(title), _(" Row %d "), k + 1);
+		rowvbox = gkrellm_gtk_framed_vbox(vbox, title, 2, FALSE, 4, 4);
+
+		gkrellm_gtk_entry_connected(rowvbox,
+		                            NULL,
+		                            derived_edit[k].label,
+		                            FALSE,
+		                            FALSE,
+		                            0,
+		                            cb_derived_label,
+		                            GINT_TO_POINTER(k),
+		                            _("Label"));
+
+		gkrellm_gtk_entry_connected(rowvbox,
+		                            NULL,
+		                            derived_edit[k].unit,
+		                            FALSE,
+		                            FALSE,
+		                            0,
+		                            cb_derived_unit,
+		                            GINT_TO_POINTER(k),
+		                            _("Unit"));
+
+		gkrellm_gtk_entry_connected(rowvbox,
+		                            &entry,
+		                            derived_edit[k].source,
+		                            FALSE,
+		                            FALSE,
+		                            0,
+		                            cb_derived_source,
+		                            GINT_TO_POINTER(k),
+		                            _("Expression"));
+
+		gkrellm_gtk_entry_set_icon(entry,
+		                           derived_edit[k].valid || derived_edit[k].source[0] == '\0');
+	}
+
+	/* what expressions can refer to */
+	len = snprintf(names, sizeof(names), "%s",
+	               _("+ - * / ( ) over counters in NVML units (MHz, C, mW, bytes, KB/s):"));
+	for (p = GPU_NAME + 1; p < GPU_PROPS_NUM; ++p)
+		len += snprintf(names + len, sizeof(names) - len,
+		                (p % 8 == 1)? "\n%s" : " %s",
+		                prop_key[p]);
+
+	gtk_box_pack_start(GTK_BOX(vbox), gtk_label_new(names), FALSE, FALSE, 4);
+}
+
+static gboolean is_gpu_choice_selected(NVGpuChoice *c)
+{
+	guint i;
+
+	if (gpu_selection_count == 0)
+		return TRUE;
+
+	for (i = 0; i < gpu_selection_count; ++i) {
+		if (!strcmp(gpu_selection[i], c->busid))
+			return TRUE;
+
+		if (!strcmp(gpu_selection[i], c->uuid)) {
+			c->by_uuid = TRUE;
+			return TRUE;
+		}
+	}
+
+	return FALSE;
+}
+
+static void cb_gpu_toggle(GtkWidget *button, gpointer data)
+{
+	guint i, checked = 0;
+	NVGpuChoice *c;
+
+	UNUSED(button);
+	UNUSED(data);
+
+	gpu_selection_count = 0;
+
+	for (i = 0; i < gpu_choice_count; ++i) {
+
+		c = &gpu_choices[i];
+
+		if (!gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(c->button)))
+			continue;
+
+		++checked;
+
+		if (gpu_selection_count < GK_MAX_GPUS)
+			strcpy(gpu_selection[gpu_selection_count++],
+			       c->by_uuid? c->uuid : c->busid);
+	}
+
+	/* all (or none) checked means every GPU, including new ones */
+	if (checked == 0 || checked == gpu_choice_count)
+		gpu_selection_count = 0;
+
+	reset_gpus = TRUE;
+}
+
+static void create_gpus_tab(GtkWidget *tabs)
+{
+	guint i, gpu_count = 0;
+	nvmlDevice_t h;
+	nvmlPciInfo_t pci;
+	NVGpuChoice *c;
+	GtkWidget *vbox, *gpuvbox;
+	gchar name[GK_MAX_TEXT], label[2 * GK_MAX_TEXT];
+
+	vbox = gkrellm_gtk_framed_notebook_page(tabs, _(" GPUs "));
+	gpuvbox = gkrellm_gtk_framed_vbox(vbox,
+	                                  _(" Monitored GPUs "),
+	                                  2,
+	                                  TRUE,
+	                                  4,
+	                                  4);
+
+	gpu_choice_count = 0;
+
+	/* the only place scanning by index, to offer every device */
+	if (is_valid_gpulib(&nvml) && NVFN(nvmlDeviceGetCount(&gpu_count)))
+		for (i = 0; i < MIN(gpu_count, GK_MAX_GPU_CHOICES); ++i) {
+
+			if (!NVFN(nvmlDeviceGetHandleByIndex(i, &h))         ||
+			    !NVFN(nvmlDeviceGetPciInfo(h, &pci))             ||
+			    !NVFN(nvmlDeviceGetName(h, name, GK_MAX_TEXT)))
+				continue;
+
+			c = &gpu_choices[gpu_choice_count++];
+			memset(c, 0, sizeof(NVGpuChoice));
+			strcpy(c->busid, pci.busId);
+
+			if (nvml.nvmlDeviceGetUUID)
+				nvml.nvmlDeviceGetUUID(h, c->uuid, GK_MAX_TEXT);
+
+			snprintf(label, sizeof(label), "%s  %s", c->busid, name);
+
+			gkrellm_gtk_check_button_connected(gpuvbox,
+			                                   &c->button,
+			                                   is_gpu_choice_selected(c),
+			                                   FALSE,
+			                                   FALSE,
+			                                   0,
+			                                   cb_gpu_toggle,
+			                                   NULL,
+			                                   label);
+		}
+
+	if (gpu_choice_count == 0)
+		gtk_box_pack_start(GTK_BOX(gpuvbox),
+		                   gtk_label_new(_("No GPU found")),
+		                   FALSE,
+		                   FALSE,
+		                   0);
+}
+
 static void create_plugin_tab(GtkWidget *tab_vbox)
 {
 	int i;
@@ -697,6 +1750,11 @@ static void create_plugin_tab(GtkWidget *tab_vbox)
 
 	gkrellm_gtk_entry_set_icon(nvml_entry, is_valid_gpulib_path(nvml.path));
 
+	gkrellm_gtk_spin_button(vbox, NULL,
+	                        precision, 0, FORMAT_MAX_PRECISION, 1, 1, 0, 60,
+	                        cb_precision, NULL, FALSE,
+	                        _("Decimal digits for GHz, W and GB values"));
+
 	cntvbox = gkrellm_gtk_framed_vbox(vbox, _(" Counters "), 2, TRUE, 4, 4);
 
 	for (i = GPU_NAME + 1; i < GPU_PROPS_NUM; ++i) {
@@ -732,16 +1790,46 @@ static void create_plugin_tab(GtkWidget *tab_vbox)
 		                 G_CALLBACK(cb_drag_data_received),
 		                 NULL);
 	}
+
+	create_gpus_tab(tabs);
+	create_sparklines_tab(tabs);
+	create_derived_tab(tabs);
+	create_sampling_tab(tabs);
+	create_reasons_tab(tabs);
 }
 
 static void apply_plugin_config(void)
 {
-	if (reset_lib) {
-		if (reinitialize_gpulib(&nvml))
+	int i, k;
+	gboolean ok;
+
+	if (reset_derived) {
+		memcpy(derived_rows, derived_edit, sizeof(derived_rows));
+
+		/* event-driven counters need a fresh read once an expression uses them */
+		for (i = 0; i < GK_MAX_GPUS; ++i)
+			for (k = 0; k < GK_MAX_DERIVED; ++k)
+				if (derived_rows[k].valid)
+					atomic_fetch_or(&gpu_info[i].dirty, derived_rows[k].expr.vars);
+	}
+
+	if (reset_lib || reset_gpus) {
+		stop_samplers();
+
+		ok = reset_lib? reinitialize_gpulib(&nvml) : is_valid_gpulib(&nvml);
+		if (ok) {
 			update_gpu_info();
+			start_samplers();
+		}
+
+		/* history files follow the GPUs, by bus id */
+		open_gpu_history();
+		rebuild_nv_panel();
+	} else if (reset_derived) {
 		rebuild_nv_panel();
-		reset_lib = FALSE;
 	}
+
+	reset_lib = reset_gpus = reset_derived = FALSE;
 }
 
 static void save_plugin_config(FILE *f)
@@ -758,6 +1846,37 @@ static void save_plugin_config(FILE *f)
 	                                 config_mask,
 	                                 config_order,
 	                                 nvml.path);
+
+	fprintf(f, "%s FORMAT %u\n", GK_CONFIG_KEYWORD, precision);
+
+	fprintf(f, "%s GPUS ", GK_CONFIG_KEYWORD);
+	for (i = 0; i < gpu_selection_count; ++i)
+		fprintf(f, "%s%s", (i > 0)? "," : "", gpu_selection[i]);
+	fprintf(f, "%s\n", (gpu_selection_count == 0)? "all" : "");
+
+	fprintf(f, "%s ADAPTIVE %d %u %u %u %u %u\n", GK_CONFIG_KEYWORD,
+	                                             adaptive.enable,
+	                                             adaptive.stable_secs,
+	                                             adaptive.idle_interval,
+	                                             adaptive.usage_threshold,
+	                                             adaptive.power_threshold,
+	                                             adaptive.delta);
+
+	fprintf(f, "%s THERMAL %u\n", GK_CONFIG_KEYWORD, thermal_margin);
+
+	/* unit (- for none), label and expression of each derived row */
+	for (i = 0; i < GK_MAX_DERIVED; ++i)
+		if (derived_rows[i].valid)
+			fprintf(f, "%s EXPR %s %s = %s\n", GK_CONFIG_KEYWORD,
+			                                   derived_rows[i].unit[0]? derived_rows[i].unit : "-",
+			                                   derived_rows[i].label,
+			                                   derived_rows[i].source);
+
+	/* width:autoscale of every property, in property order */
+	fprintf(f, "%s SPARK", GK_CONFIG_KEYWORD);
+	for (i = 0; i < GPU_PROPS_NUM; ++i)
+		fprintf(f, " %u:%d", spark_config[i].width, spark_config[i].autoscale);
+	fprintf(f, "\n");
 }
 
 static gboolean is_valid_ordering(gchar* order_string)
@@ -774,22 +1893,133 @@ static gboolean is_valid_ordering(gchar* order_string)
 	return TRUE;
 }
 
-static void load_plugin_config(gchar *arg)
+static void load_adaptive_config(gchar *config_line)
+{
+	int enable;
+	NVAdaptiveConfig cfg;
+
+	if (sscanf(config_line, "%d %u %u %u %u %u", &enable,
+	                                             &cfg.stable_secs,
+	                                             &cfg.idle_interval,
+	                                             &cfg.usage_threshold,
+	                                             &cfg.power_threshold,
+	                                             &cfg.delta) == 6) {
+		cfg.enable = (enable != 0);
+		cfg.stable_secs = CLAMP(cfg.stable_secs, 1u, 600u);
+		cfg.idle_interval = CLAMP(cfg.idle_interval, 2u, 60u);
+		cfg.usage_threshold = CLAMP(cfg.usage_threshold, 1u, 100u);
+		cfg.power_threshold = MIN(cfg.power_threshold, 1000u);
+		cfg.delta = CLAMP(cfg.delta, 1u, 100u);
+		adaptive = cfg;
+	}
+}
+
+static void load_thermal_config(gchar *config_line)
+{
+	guint margin;
+
+	if (sscanf(config_line, "%u", &margin) == 1)
+		thermal_margin = MIN(margin, 3600u);
+}
+
+static void load_derived_config(gchar *config_line)
+{
+	int n = 0;
+	size_t len;
+	gchar unit[GK_MAX_UNIT_TEXT], *label, *source;
+	NVDerivedRow *r;
+
+	if (derived_count == GK_MAX_DERIVED)
+		return;
+
+	if (sscanf(config_line, "%15s %n", unit, &n) != 1 || n == 0)
+		return;
+
+	label = config_line + n;
+	source = strchr(label, '=');
+	if (!source)
+		return;
+
+	for (*source++ = '\0'; *source == ' '; ++source)
+		;
+
+	for (len = strlen(label); len > 0 && label[len - 1] == ' '; )
+		label[--len] = '\0';
+
+	r = &derived_rows[derived_count];
+	set_derived_source(r, source);
+
+	if (r->valid) {
+		snprintf(r->label, sizeof(r->label), "%s", label);
+		set_derived_unit(r, strcmp(unit, "-")? unit : "", GK_MAX_UNIT_TEXT);
+		++derived_count;
+	}
+}
+
+static void load_spark_config(gchar *config_line)
+{
+	int autoscale;
+	guint i = 0, width;
+	gchar *item;
+
+	for (item = strtok(config_line, " "); item && i < GPU_PROPS_NUM;
+	     item = strtok(NULL, " "), ++i)
+		if (sscanf(item, "%u:%d", &width, &autoscale) == 2) {
+			spark_config[i].width = MIN(width, GK_MAX_SPARK_W);
+			spark_config[i].autoscale = (autoscale != 0);
+		}
+}
+
+static void load_gpus_config(gchar *config_line)
+{
+	gchar *id;
+
+	gpu_selection_count = 0;
+
+	for (id = strtok(config_line, ", "); id; id = strtok(NULL, ", ")) {
+
+		if (!strcmp(id, "all") || gpu_selection_count == GK_MAX_GPUS)
+			break;
+
+		snprintf(gpu_selection[gpu_selection_count++], GK_MAX_TEXT, "%s", id);
+	}
+}
+
+static void load_format_config(gchar *config_line)
+{
+	guint digits;
+
+	if (sscanf(config_line, "%u", &digits) == 1)
+		precision = MIN(digits, FORMAT_MAX_PRECISION);
+}
+
+/* orderings saved before new counters were added lack their letters */
+static void upgrade_ordering(gchar* order_string)
+{
+	char c;
+	size_t len = strlen(order_string);
+
+	for (c = 'a'; c < 'a' + GPU_PROPS_NUM && len < GPU_PROPS_NUM; ++c)
+		if (!strchr(order_string, c)) {
+			order_string[len++] = c;
+			order_string[len] = '\0';
+		}
+}
+
+static void load_nvml_config(gchar *config_key, gchar *config_line)
 {
-	gchar config_key[16], config_order[16];
-	gchar config_line[GK_MAX_PATH];
+	gchar config_order[32];
 	gboolean read_config_ok = FALSE;
 	guint i, prop_mask, config_mask, i_cfg, i_idx, j_idx;
-	
-	if (sscanf(arg, "%15s %511[^\n]", config_key, config_line) == 2) {
-	
-		if (!strcmp(config_key, "NVML"))
-			if (sscanf(config_line, "%u %15s %511s", &config_mask,
-			                                         config_order,
-			                                         nvml.path) == 3)
-				read_config_ok = is_valid_ordering(config_order) &&
-				                 is_valid_gpulib_path(nvml.path);
-	}
+
+	if (!strcmp(config_key, "NVML"))
+		if (sscanf(config_line, "%u %31s %511s", &config_mask,
+		                                         config_order,
+		                                         nvml.path) == 3) {
+			upgrade_ordering(config_order);
+			read_config_ok = is_valid_ordering(config_order) &&
+			                 is_valid_gpulib_path(nvml.path);
+		}
 
 	if (read_config_ok) {
 
@@ -811,14 +2041,39 @@ static void load_plugin_config(gchar *arg)
 
 		strcpy(nvml.path, GKFREQ_NVML_SONAME);
 
+		/* slow throughput counters are opt-in */
 		for (i = 0; i < GPU_PROPS_NUM; ++i)
-			decal_info[i].enable = TRUE;
+			decal_info[i].enable = (decal_info[i].order < GK_FIRST_SLOW_PROP ||
+			                        decal_info[i].order > GK_LAST_SLOW_PROP);
 
 		for (i = 0; i < GK_MAX_GPUS; ++i)
 			gpu_info[i].good = FALSE;
 	}
 }
 
+static void load_plugin_config(gchar *arg)
+{
+	gchar config_key[16], config_line[GK_MAX_PATH];
+
+	if (sscanf(arg, "%15s %511[^\n]", config_key, config_line) != 2)
+		config_key[0] = config_line[0] = '\0';
+
+	if (!strcmp(config_key, "ADAPTIVE"))
+		load_adaptive_config(config_line);
+	else if (!strcmp(config_key, "FORMAT"))
+		load_format_config(config_line);
+	else if (!strcmp(config_key, "GPUS"))
+		load_gpus_config(config_line);
+	else if (!strcmp(config_key, "SPARK"))
+		load_spark_config(config_line);
+	else if (!strcmp(config_key, "THERMAL"))
+		load_thermal_config(config_line);
+	else if (!strcmp(config_key, "EXPR"))
+		load_derived_config(config_line);
+	else
+		load_nvml_config(config_key, config_line);
+}
+
 static GkrellmMonitor plugin_mon =
 {
 	GK_PLUGIN_NAME,              /* Name, for config tab.                    */
@@ -848,5 +2103,12 @@ GkrellmMonitor* gkrellm_init_plugin(void)
 	plugin.style_id = gkrellm_add_meter_style(&plugin_mon, GK_PLUGIN_NAME);
 	plugin.monitor = &plugin_mon;
 
+	snprintf(user_dir, sizeof(user_dir), "%s/%s", gkrellm_homedir(), GKRELLM_DIR);
+
+	init_gpu_sampler();
+	set_caps_cache_dir(user_dir);
+	set_gpu_event_callback(notify_gpu_event);
+	attach_gpu_data(&panel_cursor);
+
 	return plugin.monitor;
 }
@@ -80,19 +80,54 @@ boolean initialize_gpulib(GKNVMLLib *lib)
 			lib->BIND_FUNCTION(nvmlDeviceGetCount);
 			lib->BIND_FUNCTION(nvmlDeviceGetHandleByIndex);
 			lib->BIND_FUNCTION(nvmlDeviceGetName);
+			lib->BIND_FUNCTION(nvmlDeviceGetPciInfo);
+
+			res = (dlerror() == NULL);
+
+			/* optional symbols, older drivers may lack some of them */
 			lib->BIND_FUNCTION(nvmlDeviceGetClockInfo);
 			lib->BIND_FUNCTION(nvmlDeviceGetTemperature);
+			lib->BIND_FUNCTION(nvmlDeviceGetTemperatureThreshold);
 			lib->BIND_FUNCTION(nvmlDeviceGetFanSpeed_v2);
 			lib->BIND_FUNCTION(nvmlDeviceGetPowerUsage);
 			lib->BIND_FUNCTION(nvmlDeviceGetUtilizationRates);
 			lib->BIND_FUNCTION(nvmlDeviceGetMemoryInfo_v2);
-			lib->BIND_FUNCTION(nvmlDeviceGetPciInfo);
 			lib->BIND_FUNCTION(nvmlDeviceGetNumFans);
 			lib->BIND_FUNCTION(nvmlDeviceGetFanSpeedRPM);
+			lib->BIND_FUNCTION(nvmlSystemGetDriverVersion);
+			lib->BIND_FUNCTION(nvmlDeviceGetHandleByPciBusId_v2);
+			lib->BIND_FUNCTION(nvmlDeviceGetHandleByUUID);
+			lib->BIND_FUNCTION(nvmlDeviceGetUUID);
+			lib->BIND_FUNCTION(nvmlDeviceGetPcieThroughput);
+			lib->BIND_FUNCTION(nvmlDeviceGetNvLinkState);
+			lib->BIND_FUNCTION(nvmlDeviceGetFieldValues);
+			lib->BIND_FUNCTION(nvmlDeviceGetCurrentClocksEventReasons);
+			lib->BIND_FUNCTION(nvmlDeviceGetMigMode);
+			lib->BIND_FUNCTION(nvmlDeviceGetMaxMigDeviceCount);
+			lib->BIND_FUNCTION(nvmlDeviceGetMigDeviceHandleByIndex);
+			lib->BIND_FUNCTION(nvmlEventSetCreate);
+			lib->BIND_FUNCTION(nvmlEventSetFree);
+			lib->BIND_FUNCTION(nvmlEventSetWait_v2);
+			lib->BIND_FUNCTION(nvmlDeviceGetSupportedEventTypes);
+			lib->BIND_FUNCTION(nvmlDeviceRegisterEvents);
+
+			if (!lib->nvmlDeviceGetHandleByPciBusId_v2)
+				lib->nvmlDeviceGetHandleByPciBusId_v2 = (nvmlDeviceGetHandleByPciBusId_v2_fn)
+				                                        dlsym(lib->handle, "nvmlDeviceGetHandleByPciBusId");
+
+			if (!lib->nvmlEventSetWait_v2)
+				lib->nvmlEventSetWait_v2 = (nvmlEventSetWait_v2_fn)
+				                           dlsym(lib->handle, "nvmlEventSetWait");
+
+			if (!lib->nvmlDeviceGetCurrentClocksEventReasons)
+				lib->nvmlDeviceGetCurrentClocksEventReasons = (nvmlDeviceGetCurrentClocksEventReasons_fn)
+				                                              dlsym(lib->handle, "nvmlDeviceGetCurrentClocksThrottleReasons");
 
 #undef BIND_FUNCTION
 
-			res = (dlerror() == NULL && lib->nvmlInit() == NVML_SUCCESS);
+			dlerror();
+
+			res = (res && lib->nvmlInit() == NVML_SUCCESS);
 		}
 
 		lib->valid = res;
@@ -101,6 +136,16 @@ boolean initialize_gpulib(GKNVMLLib *lib)
 	return res;
 }
 
+boolean has_gpulib_events(GKNVMLLib *lib)
+{
+	return is_valid_gpulib(lib)                   &&
+	       lib->nvmlEventSetCreate                &&
+	       lib->nvmlEventSetFree                  &&
+	       lib->nvmlEventSetWait_v2               &&
+	       lib->nvmlDeviceGetSupportedEventTypes  &&
+	       lib->nvmlDeviceRegisterEvents;
+}
+
 boolean reinitialize_gpulib(GKNVMLLib *lib)
 {
 	shutdown_gpulib(lib);
@@ -18,13 +18,27 @@
  * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA *
  *                                                                           *
  *****************************************************************************/
+#ifndef NVML_LIB_H
+#define NVML_LIB_H
+
 typedef int boolean;
 typedef unsigned int uint;
 typedef unsigned long long uint64;
 
-typedef enum { NVML_SUCCESS, NVML_ERROR_UNKNOWN = 999 } nvmlReturn_t;
+typedef enum {
+	NVML_SUCCESS,
+	NVML_ERROR_NOT_SUPPORTED = 3,
+	NVML_ERROR_NOT_FOUND = 6,
+	NVML_ERROR_TIMEOUT = 10,
+	NVML_ERROR_GPU_IS_LOST = 15,
+	NVML_ERROR_UNKNOWN = 999
+} nvmlReturn_t;
 typedef enum { NVML_CLOCK_GFX, NVML_CLOCK_MEM = 2 } nvmlClockType_t;
 typedef enum { NVML_TEMP_GPU } nvmlSensors_t;
+typedef enum {
+	NVML_TEMPERATURE_THRESHOLD_SHUTDOWN,
+	NVML_TEMPERATURE_THRESHOLD_SLOWDOWN
+} nvmlTemperatureThresholds_t;
 
 #define NVML_API_VERSION(name, ver) (uint)(sizeof(name) | (ver << 24u))
 
@@ -57,6 +71,65 @@ typedef struct {
 	uint unused[9];
 } nvmlPciInfo_t;
 
+#define NVML_DEVICE_UUID_BUFFER_SIZE 80
+#define NVML_SYSTEM_DRIVER_VERSION_BUFFER_SIZE 80
+#define NVML_NVLINK_MAX_LINKS 18
+
+#define NVML_DEVICE_MIG_DISABLE 0
+#define NVML_DEVICE_MIG_ENABLE 1
+
+typedef enum { NVML_FEATURE_DISABLED, NVML_FEATURE_ENABLED } nvmlEnableState_t;
+typedef enum { NVML_PCIE_UTIL_TX_BYTES, NVML_PCIE_UTIL_RX_BYTES } nvmlPcieUtilCounter_t;
+
+typedef union {
+	double dVal;
+	uint uiVal;
+	unsigned long ulVal;
+	uint64 ullVal;
+	long long sllVal;
+	int siVal;
+	unsigned short usVal;
+} nvmlValue_t;
+
+typedef struct {
+	uint fieldId;
+	uint scopeId;
+	long long timestamp;
+	long long latencyUsec;
+	int valueType;
+	nvmlReturn_t nvmlReturn;
+	nvmlValue_t value;
+} nvmlFieldValue_t;
+
+/* cumulative NVLink data in KiB, scopeId selects the link */
+#define NVML_FI_DEV_NVLINK_THROUGHPUT_DATA_TX 138
+#define NVML_FI_DEV_NVLINK_THROUGHPUT_DATA_RX 139
+
+typedef void* nvmlEventSet_t;
+
+typedef struct {
+	nvmlDevice_t device;
+	uint64 eventType;
+	uint64 eventData;
+	uint gpuInstanceId;
+	uint computeInstanceId;
+} nvmlEventData_t;
+
+#define nvmlEventTypePState           0x0004ull
+#define nvmlEventTypeXidCriticalError 0x0008ull
+#define nvmlEventTypeClock            0x0010ull
+
+/* why clocks are below their maximum, "throttle reasons" before r535 */
+#define nvmlClocksEventReasonGpuIdle                   0x0001ull
+#define nvmlClocksEventReasonApplicationsClocksSetting 0x0002ull
+#define nvmlClocksEventReasonSwPowerCap                0x0004ull
+#define nvmlClocksThrottleReasonHwSlowdown             0x0008ull
+#define nvmlClocksEventReasonSyncBoost                 0x0010ull
+#define nvmlClocksEventReasonSwThermalSlowdown         0x0020ull
+#define nvmlClocksThrottleReasonHwThermalSlowdown      0x0040ull
+#define nvmlClocksThrottleReasonHwPowerBrakeSlowdown   0x0080ull
+#define nvmlClocksEventReasonDisplayClockSetting       0x0100ull
+
 #define DECLARE_FUNCTION(f, ...) typedef nvmlReturn_t (*f ## _fn)(__VA_ARGS__)
 DECLARE_FUNCTION(nvmlInit, void);
 DECLARE_FUNCTION(nvmlShutdown, void);
@@ -65,6 +138,7 @@ DECLARE_FUNCTION(nvmlDeviceGetHandleByIndex, uint, nvmlDevice_t*);
 DECLARE_FUNCTION(nvmlDeviceGetName, nvmlDevice_t, char*, uint);
 DECLARE_FUNCTION(nvmlDeviceGetClockInfo, nvmlDevice_t, nvmlClockType_t, uint*);
 DECLARE_FUNCTION(nvmlDeviceGetTemperature, nvmlDevice_t, nvmlSensors_t, uint*);
+DECLARE_FUNCTION(nvmlDeviceGetTemperatureThreshold, nvmlDevice_t, nvmlTemperatureThresholds_t, uint*);
 DECLARE_FUNCTION(nvmlDeviceGetFanSpeed_v2, nvmlDevice_t, uint, uint*);
 DECLARE_FUNCTION(nvmlDeviceGetPowerUsage, nvmlDevice_t, uint*);
 DECLARE_FUNCTION(nvmlDeviceGetUtilizationRates, nvmlDevice_t, nvmlUsage_t*);
@@ -72,6 +146,22 @@ DECLARE_FUNCTION(nvmlDeviceGetMemoryInfo_v2, nvmlDevice_t, nvmlMemory_t*);
 DECLARE_FUNCTION(nvmlDeviceGetPciInfo, nvmlDevice_t, nvmlPciInfo_t*);
 DECLARE_FUNCTION(nvmlDeviceGetNumFans, nvmlDevice_t, uint*);
 DECLARE_FUNCTION(nvmlDeviceGetFanSpeedRPM, nvmlDevice_t, nvmlFan_t*);
+DECLARE_FUNCTION(nvmlSystemGetDriverVersion, char*, uint);
+DECLARE_FUNCTION(nvmlDeviceGetHandleByPciBusId_v2, const char*, nvmlDevice_t*);
+DECLARE_FUNCTION(nvmlDeviceGetHandleByUUID, const char*, nvmlDevice_t*);
+DECLARE_FUNCTION(nvmlDeviceGetUUID, nvmlDevice_t, char*, uint);
+DECLARE_FUNCTION(nvmlDeviceGetPcieThroughput, nvmlDevice_t, nvmlPcieUtilCounter_t, uint*);
+DECLARE_FUNCTION(nvmlDeviceGetNvLinkState, nvmlDevice_t, uint, nvmlEnableState_t*);
+DECLARE_FUNCTION(nvmlDeviceGetFieldValues, nvmlDevice_t, int, nvmlFieldValue_t*);
+DECLARE_FUNCTION(nvmlDeviceGetCurrentClocksEventReasons, nvmlDevice_t, uint64*);
+DECLARE_FUNCTION(nvmlDeviceGetMigMode, nvmlDevice_t, uint*, uint*);
+DECLARE_FUNCTION(nvmlDeviceGetMaxMigDeviceCount, nvmlDevice_t, uint*);
+DECLARE_FUNCTION(nvmlDeviceGetMigDeviceHandleByIndex, nvmlDevice_t, uint, nvmlDevice_t*);
+DECLARE_FUNCTION(nvmlEventSetCreate, nvmlEventSet_t*);
+DECLARE_FUNCTION(nvmlEventSetFree, nvmlEventSet_t);
+DECLARE_FUNCTION(nvmlEventSetWait_v2, nvmlEventSet_t, nvmlEventData_t*, uint);
+DECLARE_FUNCTION(nvmlDeviceGetSupportedEventTypes, nvmlDevice_t, uint64*);
+DECLARE_FUNCTION(nvmlDeviceRegisterEvents, nvmlDevice_t, uint64, nvmlEventSet_t);
 #undef DECLARE_FUNCTION
 
 typedef struct {
@@ -84,15 +174,34 @@ typedef struct {
 	nvmlDeviceGetCount_fn nvmlDeviceGetCount;
 	nvmlDeviceGetHandleByIndex_fn nvmlDeviceGetHandleByIndex;
 	nvmlDeviceGetName_fn nvmlDeviceGetName;
+	nvmlDeviceGetPciInfo_fn nvmlDeviceGetPciInfo;
+
+	/* optional, NULL when missing from the loaded library */
 	nvmlDeviceGetClockInfo_fn nvmlDeviceGetClockInfo;
 	nvmlDeviceGetTemperature_fn nvmlDeviceGetTemperature;
+	nvmlDeviceGetTemperatureThreshold_fn nvmlDeviceGetTemperatureThreshold;
 	nvmlDeviceGetFanSpeed_v2_fn nvmlDeviceGetFanSpeed_v2;
 	nvmlDeviceGetPowerUsage_fn nvmlDeviceGetPowerUsage;
 	nvmlDeviceGetUtilizationRates_fn nvmlDeviceGetUtilizationRates;
 	nvmlDeviceGetMemoryInfo_v2_fn nvmlDeviceGetMemoryInfo_v2;
-	nvmlDeviceGetPciInfo_fn nvmlDeviceGetPciInfo;
 	nvmlDeviceGetNumFans_fn nvmlDeviceGetNumFans;
 	nvmlDeviceGetFanSpeedRPM_fn nvmlDeviceGetFanSpeedRPM;
+	nvmlSystemGetDriverVersion_fn nvmlSystemGetDriverVersion;
+	nvmlDeviceGetHandleByPciBusId_v2_fn nvmlDeviceGetHandleByPciBusId_v2;
+	nvmlDeviceGetHandleByUUID_fn nvmlDeviceGetHandleByUUID;
+	nvmlDeviceGetUUID_fn nvmlDeviceGetUUID;
+	nvmlDeviceGetPcieThroughput_fn nvmlDeviceGetPcieThroughput;
+	nvmlDeviceGetNvLinkState_fn nvmlDeviceGetNvLinkState;
+	nvmlDeviceGetFieldValues_fn nvmlDeviceGetFieldValues;
+	nvmlDeviceGetCurrentClocksEventReasons_fn nvmlDeviceGetCurrentClocksEventReasons;
+	nvmlDeviceGetMigMode_fn nvmlDeviceGetMigMode;
+	nvmlDeviceGetMaxMigDeviceCount_fn nvmlDeviceGetMaxMigDeviceCount;
+	nvmlDeviceGetMigDeviceHandleByIndex_fn nvmlDeviceGetMigDeviceHandleByIndex;
+	nvmlEventSetCreate_fn nvmlEventSetCreate;
+	nvmlEventSetFree_fn nvmlEventSetFree;
+	nvmlEventSetWait_v2_fn nvmlEventSetWait_v2;
+	nvmlDeviceGetSupportedEventTypes_fn nvmlDeviceGetSupportedEventTypes;
+	nvmlDeviceRegisterEvents_fn nvmlDeviceRegisterEvents;
 } GKNVMLLib;
 
 boolean initialize_gpulib(GKNVMLLib *lib);
@@ -100,3 +209,6 @@ boolean reinitialize_gpulib(GKNVMLLib *lib);
 void shutdown_gpulib(GKNVMLLib *lib);
 boolean is_valid_gpulib(GKNVMLLib *lib);
 boolean is_valid_gpulib_path(char *path);
+boolean has_gpulib_events(GKNVMLLib *lib);
+
+#endif /* NVML_LIB_H */
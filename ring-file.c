@@ -0,0 +1,170 @@
+/*****************************************************************************
+ * GKrellM nVidia                                                            *
+ * A plugin for GKrellM showing nVidia GPU info using libNVML                *
+ * Copyright (C) 2025 Carlo Casta <carlo.casta@gmail.com>                    *
+ *                                                                           *
+ * This program is free software; you can redistribute it and/or modify      *  
+ * it under the terms of the GNU General Public License as published by      *
+ * the Free Software Foundation; either version 2 of the License, or         *
+ * (at your option) any later version.                                       *
+ *                                                                           *
+ * This program is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ * GNU General Public License for more details.                              *
+ *                                                                           *
+ * You should have received a copy of the GNU General Public License         *
+ * along with this program; if not, write to the Free Software               *
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA *
+ *                                                                           *
+ *****************************************************************************/
+#include "ring-file.h"
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define RING_FILE_MAGIC 0x484e4b47u   /* "GKNH" */
+#define RING_FILE_VERSION 2
+
+typedef struct {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t fields;
+	uint32_t slots;
+	char key[RING_FILE_MAX_KEY];
+	uint32_t checksum;   /* of everything above */
+	uint32_t reserved;
+	unsigned long long count;
+} RingFileHeader;
+
+/* FNV-1a of the fixed part, the count changes on every record */
+static uint32_t ring_file_checksum(const RingFileHeader *h)
+{
+	const unsigned char *p = (const unsigned char *)h;
+	size_t i;
+	uint32_t sum = 2166136261u;
+
+	for (i = 0; i < offsetof(RingFileHeader, checksum); ++i)
+		sum = (sum ^ p[i]) * 16777619u;
+
+	return sum;
+}
+
+static void ring_file_reset(RingFileHeader *h,
+                            const char *key,
+                            unsigned int fields,
+                            unsigned int slots,
+                            size_t size)
+{
+	memset(h, 0, size);
+
+	h->magic = RING_FILE_MAGIC;
+	h->version = RING_FILE_VERSION;
+	h->fields = fields;
+	h->slots = slots;
+	strncpy(h->key, key, RING_FILE_MAX_KEY - 1);
+	h->checksum = ring_file_checksum(h);
+}
+
+static int ring_file_valid(const RingFileHeader *h,
+                           const char *key,
+                           unsigned int fields,
+                           unsigned int slots)
+{
+	return h->magic == RING_FILE_MAGIC          &&
+	       h->version == RING_FILE_VERSION      &&
+	       h->fields == fields                  &&
+	       h->slots == slots                    &&
+	       h->checksum == ring_file_checksum(h) &&
+	       strncmp(h->key, key, RING_FILE_MAX_KEY - 1) == 0;
+}
+
+int ring_file_open(RingFile *r,
+                   const char *path,
+                   const char *key,
+                   unsigned int fields,
+                   unsigned int slots)
+{
+	int fd;
+	struct stat st;
+	RingFileHeader *h;
+	size_t size = sizeof(RingFileHeader) +
+	              (size_t)(fields + 1) * slots * sizeof(unsigned long long);
+
+	memset(r, 0, sizeof(RingFile));
+
+	if (fields == 0 || slots == 0)
+		return 0;
+
+	if ((fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644)) < 0)
+		return 0;
+
+	/* a file of any other size can't be ours */
+	if (fstat(fd, &st) != 0 ||
+	    ((size_t)st.st_size != size && ftruncate(fd, (off_t)size) != 0)) {
+		close(fd);
+		return 0;
+	}
+
+	h = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+
+	if (h == MAP_FAILED)
+		return 0;
+
+	if ((size_t)st.st_size != size || !ring_file_valid(h, key, fields, slots))
+		ring_file_reset(h, key, fields, slots, size);
+
+	r->map = h;
+	r->map_size = size;
+	r->records = (unsigned long long *)(h + 1);
+	r->fields = fields;
+	r->slots = slots;
+	r->count = &h->count;
+
+	return 1;
+}
+
+void ring_file_close(RingFile *r)
+{
+	if (r->map)
+		munmap(r->map, r->map_size);
+
+	memset(r, 0, sizeof(RingFile));
+}
+
+static unsigned long long *ring_file_slot(const RingFile *r, unsigned long long n)
+{
+	return r->records + (n % r->slots) * (r->fields + 1);
+}
+
+unsigned long long *ring_file_begin(RingFile *r)
+{
+	return ring_file_slot(r, *r->count) + 1;
+}
+
+void ring_file_commit(RingFile *r, unsigned long long time)
+{
+	*ring_file_slot(r, *r->count) = time;
+	++*r->count;
+}
+
+unsigned int ring_file_count(const RingFile *r)
+{
+	return (*r->count < r->slots)? (unsigned int)*r->count : r->slots;
+}
+
+const unsigned long long *ring_file_get(const RingFile *r,
+                                        unsigned int age,
+                                        unsigned long long *time)
+{
+	const unsigned long long *slot = ring_file_slot(r, *r->count - 1 - age);
+
+	if (time)
+		*time = slot[0];
+
+	return slot + 1;
+}
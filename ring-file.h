@@ -0,0 +1,74 @@
+/*****************************************************************************
+ * GKrellM nVidia                                                            *
+ * A plugin for GKrellM showing nVidia GPU info using libNVML                *
+ * Copyright (C) 2025 Carlo Casta <carlo.casta@gmail.com>                    *
+ *                                                                           *
+ * This program is free software; you can redistribute it and/or modify      *  
+ * it under the terms of the GNU General Public License as published by      *
+ * the Free Software Foundation; either version 2 of the License, or         *
+ * (at your option) any later version.                                       *
+ *                                                                           *
+ * This program is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ * GNU General Public License for more details.                              *
+ *                                                                           *
+ * You should have received a copy of the GNU General Public License         *
+ * along with this program; if not, write to the Free Software               *
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA *
+ *                                                                           *
+ *****************************************************************************/
+#ifndef RING_FILE_H
+#define RING_FILE_H
+
+#include <stddef.h>
+
+/*
+ * fixed size ring of records of 64 bit fields, kept in a memory mapped
+ * file so it survives restarts. Opening maps the file as it is, nothing
+ * is parsed: a header with magic, version, geometry, key and a checksum
+ * of all that is compared and a file not matching is started over.
+ * Records are written straight into the mapping, the kernel writes them
+ * back on its own. Every record carries the (wall clock) time it was
+ * committed at, so readers can tell how old it is.
+ */
+#define RING_FILE_MAX_KEY 64
+
+/* map is NULL while closed */
+typedef struct {
+	void *map;
+	size_t map_size;
+	unsigned long long *records;   /* slots of time, then fields */
+	unsigned int fields;
+	unsigned int slots;
+	unsigned long long *count;   /* records written so far, in the file */
+} RingFile;
+
+/*
+ * map path, creating or resetting it when it doesn't hold a ring for
+ * key with this geometry. Returns 0 (and r closed) on failure.
+ */
+int ring_file_open(RingFile *r,
+                   const char *path,
+                   const char *key,
+                   unsigned int fields,
+                   unsigned int slots);
+
+void ring_file_close(RingFile *r);
+
+/* writer side: fill the fields of the returned record, then commit it */
+unsigned long long *ring_file_begin(RingFile *r);
+void ring_file_commit(RingFile *r, unsigned long long time);
+
+/* records available, at most slots */
+unsigned int ring_file_count(const RingFile *r);
+
+/*
+ * fields of the record written age commits ago (0 = newest) and its
+ * time if time isn't NULL, age < ring_file_count()
+ */
+const unsigned long long *ring_file_get(const RingFile *r,
+                                        unsigned int age,
+                                        unsigned long long *time);
+
+#endif /* RING_FILE_H */
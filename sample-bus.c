@@ -0,0 +1,132 @@
+/*****************************************************************************
+ * GKrellM nVidia                                                            *
+ * A plugin for GKrellM showing nVidia GPU info using libNVML                *
+ * Copyright (C) 2025 Carlo Casta <carlo.casta@gmail.com>                    *
+ *                                                                           *
+ * This program is free software; you can redistribute it and/or modify      *  
+ * it under the terms of the GNU General Public License as published by      *
+ * the Free Software Foundation; either version 2 of the License, or         *
+ * (at your option) any later version.                                       *
+ *                                                                           *
+ * This program is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ * GNU General Public License for more details.                              *
+ *                                                                           *
+ * You should have received a copy of the GNU General Public License         *
+ * along with this program; if not, write to the Free Software               *
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA *
+ *                                                                           *
+ *****************************************************************************/
+#include "sample-bus.h"
+#include <string.h>
+
+typedef unsigned long long uint64;
+
+/* record n is being written while its slot holds 2n+1, done at 2n+2 */
+#define SEQ_WRITING(n) (2 * (n) + 1)
+#define SEQ_DONE(n) (2 * (n) + 2)
+
+static unsigned char *slot_record(SampleBus *bus, uint64 n)
+{
+	return bus->records + (n & bus->mask) * bus->record_size;
+}
+
+void sample_bus_init(SampleBus *bus,
+                     void *records,
+                     atomic_ullong *slot_seq,
+                     size_t record_size,
+                     unsigned int slots)
+{
+	unsigned int i;
+
+	bus->records = records;
+	bus->slot_seq = slot_seq;
+	bus->record_size = record_size;
+	bus->mask = slots - 1;
+	atomic_init(&bus->head, 0);
+
+	for (i = 0; i < slots; ++i)
+		atomic_init(&slot_seq[i], 0);
+}
+
+void *sample_bus_begin(SampleBus *bus)
+{
+	uint64 n = atomic_load_explicit(&bus->head, memory_order_relaxed);
+
+	atomic_store_explicit(&bus->slot_seq[n & bus->mask],
+	                      SEQ_WRITING(n),
+	                      memory_order_relaxed);
+	atomic_thread_fence(memory_order_release);
+
+	return slot_record(bus, n);
+}
+
+void sample_bus_commit(SampleBus *bus)
+{
+	uint64 n = atomic_load_explicit(&bus->head, memory_order_relaxed);
+
+	atomic_store_explicit(&bus->slot_seq[n & bus->mask],
+	                      SEQ_DONE(n),
+	                      memory_order_release);
+	atomic_store_explicit(&bus->head, n + 1, memory_order_release);
+}
+
+void sample_bus_attach(SampleBus *bus, SampleCursor *cursor)
+{
+	cursor->next = atomic_load_explicit(&bus->head, memory_order_acquire);
+	cursor->skipped = 0;
+}
+
+int sample_bus_read(SampleBus *bus, SampleCursor *cursor, void *out)
+{
+	uint64 head, n, s1, s2;
+
+	for (;;) {
+
+		head = atomic_load_explicit(&bus->head, memory_order_acquire);
+		if (cursor->next >= head)
+			return 0;
+
+		/* consumer fell a whole ring behind, drop what was overwritten */
+		if (head - cursor->next > bus->mask + 1) {
+			cursor->skipped += head - (bus->mask + 1) - cursor->next;
+			cursor->next = head - (bus->mask + 1);
+		}
+
+		n = cursor->next++;
+
+		s1 = atomic_load_explicit(&bus->slot_seq[n & bus->mask],
+		                          memory_order_acquire);
+		if (s1 != SEQ_DONE(n)) {
+			++cursor->skipped;
+			continue;
+		}
+
+		memcpy(out, slot_record(bus, n), bus->record_size);
+		atomic_thread_fence(memory_order_acquire);
+
+		/* producer lapped us while copying: torn, skip it */
+		s2 = atomic_load_explicit(&bus->slot_seq[n & bus->mask],
+		                          memory_order_relaxed);
+		if (s2 == s1)
+			return 1;
+
+		++cursor->skipped;
+	}
+}
+
+int sample_bus_read_latest(SampleBus *bus, SampleCursor *cursor, void *out)
+{
+	uint64 head = atomic_load_explicit(&bus->head, memory_order_acquire);
+
+	if (cursor->next >= head)
+		return 0;
+
+	if (head - cursor->next > 1) {
+		cursor->skipped += head - 1 - cursor->next;
+		cursor->next = head - 1;
+	}
+
+	return sample_bus_read(bus, cursor, out);
+}
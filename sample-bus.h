@@ -0,0 +1,70 @@
+/*****************************************************************************
+ * GKrellM nVidia                                                            *
+ * A plugin for GKrellM showing nVidia GPU info using libNVML                *
+ * Copyright (C) 2025 Carlo Casta <carlo.casta@gmail.com>                    *
+ *                                                                           *
+ * This program is free software; you can redistribute it and/or modify      *  
+ * it under the terms of the GNU General Public License as published by      *
+ * the Free Software Foundation; either version 2 of the License, or         *
+ * (at your option) any later version.                                       *
+ *                                                                           *
+ * This program is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ * GNU General Public License for more details.                              *
+ *                                                                           *
+ * You should have received a copy of the GNU General Public License         *
+ * along with this program; if not, write to the Free Software               *
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA *
+ *                                                                           *
+ *****************************************************************************/
+#ifndef SAMPLE_BUS_H
+#define SAMPLE_BUS_H
+
+#include <stddef.h>
+#include <stdatomic.h>
+
+/*
+ * single producer, multiple consumer ring of fixed size records.
+ * The producer never waits: every slot carries a sequence number
+ * (odd while being written) so readers can detect records that were
+ * overwritten or torn under them, skip them and move on. Each consumer
+ * owns a cursor and reads at its own pace.
+ */
+typedef struct {
+	unsigned char *records;
+	atomic_ullong *slot_seq;
+	size_t record_size;
+	unsigned long long mask;
+	atomic_ullong head;        /* records published so far */
+} SampleBus;
+
+typedef struct {
+	unsigned long long next;   /* next record to read */
+	unsigned long long skipped;
+} SampleCursor;
+
+/* slots must be a power of two, storage is owned by the caller */
+void sample_bus_init(SampleBus *bus,
+                     void *records,
+                     atomic_ullong *slot_seq,
+                     size_t record_size,
+                     unsigned int slots);
+
+/* producer side: fill the returned record, then commit it */
+void *sample_bus_begin(SampleBus *bus);
+void sample_bus_commit(SampleBus *bus);
+
+/* start reading from the next published record */
+void sample_bus_attach(SampleBus *bus, SampleCursor *cursor);
+
+/*
+ * copy the next unread record into out, returns 0 if there is none.
+ * out may have been written even then, by a record found torn.
+ */
+int sample_bus_read(SampleBus *bus, SampleCursor *cursor, void *out);
+
+/* copy the newest record into out skipping older ones, 0 if none new */
+int sample_bus_read_latest(SampleBus *bus, SampleCursor *cursor, void *out);
+
+#endif /* SAMPLE_BUS_H */
@@ -0,0 +1,125 @@
+/*****************************************************************************
+ * GKrellM nVidia                                                            *
+ * A plugin for GKrellM showing nVidia GPU info using libNVML                *
+ * Copyright (C) 2025 Carlo Casta <carlo.casta@gmail.com>                    *
+ *                                                                           *
+ * This program is free software; you can redistribute it and/or modify      *  
+ * it under the terms of the GNU General Public License as published by      *
+ * the Free Software Foundation; either version 2 of the License, or         *
+ * (at your option) any later version.                                       *
+ *                                                                           *
+ * This program is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ * GNU General Public License for more details.                              *
+ *                                                                           *
+ * You should have received a copy of the GNU General Public License         *
+ * along with this program; if not, write to the Free Software               *
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA *
+ *                                                                           *
+ *****************************************************************************/
+#include "trend-fit.h"
+
+void trend_fit_init(TrendFit *t, unsigned int size)
+{
+	t->origin = 0;
+	t->size = (size < 2)? 2 : (size > TREND_FIT_MAX)? TREND_FIT_MAX : size;
+	t->count = t->head = 0;
+	t->sx = t->sy = t->sxx = t->sxy = 0.0;
+}
+
+/* oldest sample becomes the origin, sums start again from exact values */
+static void trend_fit_rebase(TrendFit *t)
+{
+	unsigned int i, oldest = (t->head + t->size - t->count) % t->size;
+	double shift = t->x[oldest];
+
+	t->origin += (unsigned long long)(shift * 1000.0 + 0.5);
+	t->sx = t->sy = t->sxx = t->sxy = 0.0;
+
+	for (i = 0; i < t->count; ++i) {
+		t->x[i] -= shift;
+		t->sx += t->x[i];
+		t->sy += t->y[i];
+		t->sxx += t->x[i] * t->x[i];
+		t->sxy += t->x[i] * t->y[i];
+	}
+}
+
+void trend_fit_add(TrendFit *t, unsigned long long time_ms, double y)
+{
+	double x, ox, oy;
+
+	if (t->count == 0)
+		t->origin = time_ms;
+
+	x = (double)(time_ms - t->origin) / 1000.0;
+
+	if (t->count == t->size) {
+		ox = t->x[t->head];
+		oy = t->y[t->head];
+		t->sx -= ox;
+		t->sy -= oy;
+		t->sxx -= ox * ox;
+		t->sxy -= ox * oy;
+	} else {
+		++t->count;
+	}
+
+	t->x[t->head] = x;
+	t->y[t->head] = y;
+	t->sx += x;
+	t->sy += y;
+	t->sxx += x * x;
+	t->sxy += x * y;
+
+	t->head = (t->head + 1) % t->size;
+
+	if (t->head == 0)
+		trend_fit_rebase(t);
+}
+
+int trend_fit_get(const TrendFit *t,
+                  unsigned int min_count,
+                  double *slope,
+                  double *value)
+{
+	double n = t->count, den, x;
+
+	if (t->count < 2 || t->count < min_count)
+		return 0;
+
+	den = n * t->sxx - t->sx * t->sx;
+
+	/* all samples at the same instant */
+	if (den <= 1e-9 * n * n)
+		return 0;
+
+	*slope = (n * t->sxy - t->sx * t->sy) / den;
+
+	x = t->x[(t->head + t->size - 1) % t->size];
+	*value = (t->sy + *slope * (n * x - t->sx)) / n;
+
+	return 1;
+}
+
+int trend_fit_eta(const TrendFit *t,
+                  unsigned int min_count,
+                  double min_slope,
+                  double target,
+                  double *secs)
+{
+	double slope, value;
+
+	if (!trend_fit_get(t, min_count, &slope, &value))
+		return 0;
+
+	if (value >= target)
+		*secs = 0.0;
+	else if (slope >= min_slope)
+		*secs = (target - value) / slope;
+	else
+		return 0;
+
+	return 1;
+}
@@ -0,0 +1,68 @@
+/*****************************************************************************
+ * GKrellM nVidia                                                            *
+ * A plugin for GKrellM showing nVidia GPU info using libNVML                *
+ * Copyright (C) 2025 Carlo Casta <carlo.casta@gmail.com>                    *
+ *                                                                           *
+ * This program is free software; you can redistribute it and/or modify      *  
+ * it under the terms of the GNU General Public License as published by      *
+ * the Free Software Foundation; either version 2 of the License, or         *
+ * (at your option) any later version.                                       *
+ *                                                                           *
+ * This program is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ * GNU General Public License for more details.                              *
+ *                                                                           *
+ * You should have received a copy of the GNU General Public License         *
+ * along with this program; if not, write to the Free Software               *
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA *
+ *                                                                           *
+ *****************************************************************************/
+#ifndef TREND_FIT_H
+#define TREND_FIT_H
+
+/*
+ * least-squares line through the last samples of a series. Sums are
+ * updated as samples enter and leave the window so adding one costs
+ * O(1); once per window they are rebuilt from the stored samples, which
+ * moves the time origin along and drops the accumulated rounding error.
+ */
+
+#define TREND_FIT_MAX 64
+
+typedef struct {
+	unsigned long long origin;   /* ms, x = 0 */
+	double x[TREND_FIT_MAX];     /* seconds since origin */
+	double y[TREND_FIT_MAX];
+	unsigned int size;           /* window length */
+	unsigned int count;
+	unsigned int head;           /* next slot to write */
+	double sx, sy, sxx, sxy;
+} TrendFit;
+
+/* size is clamped to [2, TREND_FIT_MAX] */
+void trend_fit_init(TrendFit *t, unsigned int size);
+
+void trend_fit_add(TrendFit *t, unsigned long long time_ms, double y);
+
+/*
+ * slope (units per second) and value of the line at the newest sample,
+ * returns 0 with less than min_count samples or no spread in time
+ */
+int trend_fit_get(const TrendFit *t,
+                  unsigned int min_count,
+                  double *slope,
+                  double *value);
+
+/*
+ * seconds from the newest sample until the line reaches target, 0 when
+ * it is already there. Returns 0 like trend_fit_get(), or when the line
+ * climbs slower than min_slope (units per second).
+ */
+int trend_fit_eta(const TrendFit *t,
+                  unsigned int min_count,
+                  double min_slope,
+                  double target,
+                  double *secs);
+
+#endif /* TREND_FIT_H */
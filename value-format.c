@@ -0,0 +1,147 @@
+/*****************************************************************************
+ * GKrellM nVidia                                                            *
+ * A plugin for GKrellM showing nVidia GPU info using libNVML                *
+ * Copyright (C) 2025 Carlo Casta <carlo.casta@gmail.com>                    *
+ *                                                                           *
+ * This program is free software; you can redistribute it and/or modify      *  
+ * it under the terms of the GNU General Public License as published by      *
+ * the Free Software Foundation; either version 2 of the License, or         *
+ * (at your option) any later version.                                       *
+ *                                                                           *
+ * This program is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ * GNU General Public License for more details.                              *
+ *                                                                           *
+ * You should have received a copy of the GNU General Public License         *
+ * along with this program; if not, write to the Free Software               *
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA *
+ *                                                                           *
+ *****************************************************************************/
+#include "value-format.h"
+#include <string.h>
+
+#define MAX_SCALES 3
+#define MAX_DIGITS 24
+
+typedef unsigned long long uint64;
+
+typedef struct {
+	uint64 threshold;   /* smallest raw value using this scale */
+	uint64 divisor;     /* raw value / divisor = displayed value */
+	char suffix[5];
+	int scaled;         /* print decimals */
+} UnitScale;
+
+/* scales are sorted by decreasing threshold, last one always matches */
+static const UnitScale unit_table[UNIT_NUM][MAX_SCALES] = {
+ /* UNIT_NONE    */ { { 0,          1,          "",    0 } },
+ /* UNIT_PERCENT */ { { 0,          1,          "%",   0 } },
+ /* UNIT_CELSIUS */ { { 0,          1,          "C",   0 } },
+ /* UNIT_MHZ     */ { { 1000,       1000,       "GHz", 1 },
+                      { 0,          1,          "MHz", 0 } },
+ /* UNIT_RPM     */ { { 0,          1,          "RPM", 0 } },
+ /* UNIT_MW      */ { { 0,          1000,       "W",   1 } },
+ /* UNIT_BYTES   */ { { 1ull << 30, 1ull << 30, "GB",  1 },
+                      { 0,          1ull << 20, "MB",  0 } },
+ /* UNIT_KBPS    */ { { 1ull << 20, 1ull << 20, "GB/s", 1 },
+                      { 1ull << 10, 1ull << 10, "MB/s", 1 },
+                      { 0,          1,          "KB/s", 0 } },
+ /* UNIT_SECONDS */ { { 3600,       3600,       "h",   1 },
+                      { 60,         60,         "min", 1 },
+                      { 0,          1,          "s",   0 } }
+};
+
+/* raw value units, as shown by gknv-top -r */
+static const char *const unit_name[UNIT_NUM] = {
+	"",       /* UNIT_NONE    */
+	"%",      /* UNIT_PERCENT */
+	"C",      /* UNIT_CELSIUS */
+	"MHz",    /* UNIT_MHZ     */
+	"RPM",    /* UNIT_RPM     */
+	"mW",     /* UNIT_MW      */
+	"bytes",  /* UNIT_BYTES   */
+	"KB/s",   /* UNIT_KBPS    */
+	"s"       /* UNIT_SECONDS */
+};
+
+static const uint64 pow10[FORMAT_MAX_PRECISION + 1] = { 1, 10, 100, 1000 };
+
+/* write v right-aligned ending at end, return start */
+static char *put_uint(char *end, uint64 v)
+{
+	do {
+		*--end = '0' + (char)(v % 10);
+		v /= 10;
+	} while (v);
+
+	return end;
+}
+
+int format_value(char *buf,
+                 int buf_size,
+                 unsigned long long value,
+                 ValueUnit_t unit,
+                 unsigned int precision)
+{
+	char tmp[MAX_DIGITS + 8];
+	char *end = tmp + MAX_DIGITS;
+	char *start;
+	const UnitScale *s;
+	const char *sfx;
+	uint64 q;
+	unsigned int i;
+	int len;
+
+	if (!buf || buf_size <= 0)
+		return 0;
+
+	if (unit >= UNIT_NUM)
+		unit = UNIT_NONE;
+
+	for (s = unit_table[unit]; s->threshold > value; ++s)
+		;
+
+	if (s->scaled) {
+		precision = (precision > FORMAT_MAX_PRECISION)? FORMAT_MAX_PRECISION
+		                                              : precision;
+
+		/* fixed point, rounded to the requested decimals */
+		q = (value * pow10[precision] + s->divisor / 2) / s->divisor;
+
+		start = end;
+		for (i = 0; i < precision; ++i, q /= 10)
+			*--start = '0' + (char)(q % 10);
+
+		if (precision)
+			*--start = '.';
+
+		start = put_uint(start, q);
+	} else {
+		start = put_uint(end, value / s->divisor);
+	}
+
+	for (sfx = s->suffix; *sfx; ++sfx)
+		*end++ = *sfx;
+
+	len = (int)(end - start);
+	if (len > buf_size - 1)
+		len = buf_size - 1;
+
+	for (i = 0; i < (unsigned int)len; ++i)
+		buf[i] = start[i];
+	buf[len] = '\0';
+
+	return len;
+}
+
+ValueUnit_t value_unit_from_name(const char *name)
+{
+	int unit;
+
+	for (unit = UNIT_PERCENT; unit < UNIT_NUM; ++unit)
+		if (!strcmp(name, unit_name[unit]))
+			return (ValueUnit_t)unit;
+
+	return UNIT_NUM;
+}
@@ -0,0 +1,57 @@
+/*****************************************************************************
+ * GKrellM nVidia                                                            *
+ * A plugin for GKrellM showing nVidia GPU info using libNVML                *
+ * Copyright (C) 2025 Carlo Casta <carlo.casta@gmail.com>                    *
+ *                                                                           *
+ * This program is free software; you can redistribute it and/or modify      *  
+ * it under the terms of the GNU General Public License as published by      *
+ * the Free Software Foundation; either version 2 of the License, or         *
+ * (at your option) any later version.                                       *
+ *                                                                           *
+ * This program is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ * GNU General Public License for more details.                              *
+ *                                                                           *
+ * You should have received a copy of the GNU General Public License         *
+ * along with this program; if not, write to the Free Software               *
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA *
+ *                                                                           *
+ *****************************************************************************/
+#ifndef VALUE_FORMAT_H
+#define VALUE_FORMAT_H
+
+/* unit of the raw value as returned by NVML */
+typedef enum {
+	UNIT_NONE,
+	UNIT_PERCENT,
+	UNIT_CELSIUS,
+	UNIT_MHZ,
+	UNIT_RPM,
+	UNIT_MW,
+	UNIT_BYTES,
+	UNIT_KBPS,
+	UNIT_SECONDS,
+	UNIT_NUM
+} ValueUnit_t;
+
+#define FORMAT_MAX_PRECISION 3
+
+/*
+ * format value into buf (always NUL terminated), scaling it to the
+ * largest unit in the table for which it is at least 1. Scaled units get
+ * precision decimal digits. Returns the formatted length.
+ */
+int format_value(char *buf,
+                 int buf_size,
+                 unsigned long long value,
+                 ValueUnit_t unit,
+                 unsigned int precision);
+
+/*
+ * unit named as in raw values ("MHz", "C", "mW", "bytes", "KB/s", ...),
+ * UNIT_NUM when name isn't one of them
+ */
+ValueUnit_t value_unit_from_name(const char *name);
+
+#endif /* VALUE_FORMAT_H */